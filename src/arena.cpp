@@ -0,0 +1,120 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+
+
+
+namespace WP {
+
+
+
+Arena::Arena(size_t block_size)
+{
+
+    m_block_size = block_size;
+    m_blocks = nullptr;
+    m_pos = nullptr;
+    m_left = 0;
+    m_destructors = nullptr;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+}
+
+
+Arena::~Arena()
+{
+
+    // newest first, objects may refer to older ones
+    for (Destructor *d = m_destructors; d != nullptr; d = d->next) {
+        d->destroy(d->object);
+    }
+
+    while (m_blocks != nullptr) {
+        Block *next = m_blocks->next;
+        free(m_blocks);
+        m_blocks = next;
+    }
+
+}
+
+
+void *
+Arena::allocate(size_t size, size_t align)
+{
+
+    size_t pad = (align - ((uintptr_t) m_pos & (align - 1))) & (align - 1);
+
+    if (m_pos == nullptr || pad + size > m_left) {
+        // oversized requests get a block of their own
+        const size_t header = (sizeof(Block) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+        const size_t block_size = header + (size + align > m_block_size ? size + align : m_block_size);
+
+        Block *block = (Block*) malloc(block_size);
+        if (block == nullptr) {
+            perror("malloc");
+            abort();
+        }
+
+        block->next = m_blocks;
+        m_blocks = block;
+        m_pos = (char*) block + header;
+        m_left = block_size - header;
+        m_stats.blocks++;
+
+        pad = (align - ((uintptr_t) m_pos & (align - 1))) & (align - 1);
+    }
+
+    void *ptr = m_pos + pad;
+    m_pos += pad + size;
+    m_left -= pad + size;
+    m_stats.bytes += pad + size;
+
+    return ptr;
+
+}
+
+
+const WP::Arena::Stats &
+Arena::get_stats() const
+{
+
+    return m_stats;
+
+}
+
+
+void
+Arena::add_destructor(void *object, void (*destroy)(void *object))
+{
+
+    Destructor *d = new (allocate(sizeof(Destructor), alignof(Destructor))) Destructor;
+    d->destroy = destroy;
+    d->object = object;
+    d->next = m_destructors;
+    m_destructors = d;
+
+}
+
+
+
+} // namespace WP
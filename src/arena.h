@@ -0,0 +1,98 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+#define WP_ARENA_BLOCK_SIZE (64 * 1024)
+
+
+
+namespace WP {
+
+
+
+// bump allocator owning every object built from one config,
+// objects are destroyed in reverse order together with the arena
+class Arena
+{
+
+
+public:
+    struct Stats {
+        uint64_t objects;
+        uint64_t blocks;
+        uint64_t bytes;
+    };
+
+
+    Arena(size_t block_size = WP_ARENA_BLOCK_SIZE);
+    ~Arena();
+
+    template <typename T, typename... Args>
+    T *create(Args&&... args) {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            add_destructor(object, [](void *o) { static_cast<T*>(o)->~T(); });
+        }
+        m_stats.objects++;
+        return object;
+    }
+
+    void *allocate(size_t size, size_t align);
+
+    const WP::Arena::Stats &get_stats() const;
+
+
+private:
+    struct Destructor {
+        void (*destroy)(void *object);
+        void *object;
+        Destructor *next;
+    };
+
+    struct Block {
+        Block *next;
+    };
+
+    size_t m_block_size;
+    Block *m_blocks;
+    char *m_pos;
+    size_t m_left;
+    Destructor *m_destructors;
+    WP::Arena::Stats m_stats;
+
+    void add_destructor(void *object, void (*destroy)(void *object));
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // ARENA_H
@@ -18,8 +18,6 @@
 
 #include "axis.h"
 
-#include <stdlib.h>
-
 
 
 namespace WP {
@@ -33,8 +31,7 @@ Axis::Axis()
     m_min_max[0] = 0;
     m_min_max[1] = 0;
     m_invert = false;
-    m_value = 0;
-    m_percent = 0.0f;
+    m_filter = nullptr;
 
 }
 
@@ -100,54 +97,22 @@ Axis::set_invert(bool invert)
 }
 
 
-float
-Axis::get_value_percent() const
-{
-
-    return m_percent;
-
-}
-
-
-int32_t
-Axis::get_value() const
-{
-
-    return m_value;
-
-}
-
-
-void
-Axis::set_value(int32_t value)
+const WP::Filter *
+Axis::get_filter() const
 {
 
-    const int32_t min = get_min();
-    const int32_t max = get_max();
-    const float distance = abs(max - min);
-    const float abs_value = min < 0 ? value + abs(min) : value;
-    set_value_percent(abs_value / distance);
+    return m_filter;
 
 }
 
 
 void
-Axis::set_value_percent(float p)
+Axis::set_filter(const WP::Filter *filter)
 {
 
-    if (get_invert()) {
-        p = 1.0 - p;
-    }
-
-    const int32_t min = get_min();
-    const int32_t max = get_max();
-    const int64_t distance = abs(max - min);
-    m_value = (distance * p) + (min > 0 ? min : (min < 0 ? min : 0 + max < 0 ? max : 0));
-    m_percent = p;
+    m_filter = filter;
 
 }
 
 
-
-
 } // namespace WP
@@ -28,6 +28,7 @@ namespace WP {
 
 
 
+class Filter;
 class Axis : public WP::EventSource
 {
 
@@ -45,19 +46,15 @@ public:
     bool get_invert() const;
     void set_invert(bool invert);
 
-    float get_value_percent() const;
-    int32_t get_value() const;
-
-    void set_value_percent(float p);
-    void set_value(int32_t value);
+    const WP::Filter *get_filter() const;
+    void set_filter(const WP::Filter *filter);
 
 
 
 private:
     int32_t m_min_max[2];
     bool m_invert;
-    int32_t m_value;
-    float m_percent;
+    const WP::Filter *m_filter; // owned by the config arena
 
 
 };
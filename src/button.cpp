@@ -29,8 +29,6 @@ Button::Button()
     : WP::EventSource(WP::EventSource::TYPE_BUTTON)
 {
 
-    m_down = false;
-
 }
 
 
@@ -39,7 +37,6 @@ Button::Button(uint16_t code)
 {
 
     set_code(code);
-    m_down = false;
 
 }
 
@@ -51,23 +48,4 @@ Button::~Button()
 
 
 
-bool
-Button::get_down() const
-{
-
-    return m_down;
-
-}
-
-
-void
-Button::set_down(bool down)
-{
-
-    m_down = down;
-
-}
-
-
-
 } // namespace WP
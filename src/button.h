@@ -39,13 +39,6 @@ public:
     Button(uint16_t code);
     ~Button();
 
-    bool get_down() const;
-    void set_down(bool down);
-
-
-private:
-    bool m_down;
-
 };
 
 
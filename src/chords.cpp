@@ -0,0 +1,285 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "chords.h"
+#include "map.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+
+namespace WP {
+
+
+
+Chords::Chords()
+{
+
+    m_map = nullptr;
+    m_listener = nullptr;
+    m_words = 0;
+    m_deadline = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+}
+
+
+Chords::~Chords()
+{
+
+}
+
+
+void
+Chords::init(const WP::Map *map)
+{
+
+    m_map = map;
+    m_words = map->get_chord_words();
+    m_held.assign(m_words, 0);
+    m_used.assign(m_words, 0);
+    m_passed.assign(m_words, 0);
+    m_active.assign((map->get_chord_count() + 63) / 64, 0);
+    m_windows.assign(map->get_chord_button_count(), 0);
+    m_presses.assign(map->get_chord_button_count(), WP::Chords::Press());
+    m_deadline = 0;
+
+    // a press waits for the longest chord it is part of
+    const WP::MapChord *chords = map->get_chords();
+    const uint64_t *masks = map->get_chord_masks();
+    for (size_t c = 0, s = map->get_chord_count(); c < s; ++c) {
+        const uint64_t window = (uint64_t) chords[c].window * 1000000ULL;
+
+        for (size_t w = 0; w < m_words; ++w) {
+            for (uint64_t bits = masks[c * m_words + w]; bits != 0; bits &= bits - 1) {
+                uint64_t &button_window = m_windows[w * 64 + __builtin_ctzll(bits)];
+                if (window > button_window) button_window = window;
+            }
+        }
+    }
+
+}
+
+
+void
+Chords::set_listener(WP::Chords::Listener *listener)
+{
+
+    m_listener = listener;
+
+}
+
+
+bool
+Chords::button_changed(WP::Device *src, uint16_t slot, uint16_t button, bool down, uint64_t time)
+{
+
+    assert(m_listener != nullptr && button < m_presses.size());
+
+    if (time == 0) time = WP::Utils::get_time();
+
+    const size_t w = button / 64;
+    const uint64_t bit = 1ULL << (button % 64);
+
+    if (down) {
+        // a second down without a release, the press is already waiting or part of a chord
+        if ((m_held[w] | m_used[w]) & bit) return false;
+        // a repeat of a press that was passed on goes to its own ops like any other button
+        if (m_passed[w] & bit) return true;
+
+        // nothing is sent until the chord is complete or the window runs out
+        WP::Chords::Press &press = m_presses[button];
+        press.src = src;
+        press.slot = slot;
+        press.time = time;
+        press.deadline = time + m_windows[button];
+
+        m_held[w] |= bit;
+        m_stats.held++;
+
+        match();
+        update_deadline();
+        return false;
+    }
+
+
+    if (m_held[w] & bit) {
+        // released before the chord was complete, the press goes out first
+        m_stats.taps++;
+        pass(button, time);
+        update_deadline();
+        return true;
+    }
+
+    if (m_passed[w] & bit) {
+        // its own ops release it, chords it was part of go with it
+        m_passed[w] &= ~bit;
+        release(w, bit);
+        return true;
+    }
+
+    if (!(m_used[w] & bit)) return true;
+
+    m_used[w] &= ~bit;
+    m_stats.suppressed++;
+    release(w, bit);
+
+    return false;
+
+}
+
+
+void
+Chords::expire(uint64_t now)
+{
+
+    if (m_deadline == 0 || now < m_deadline) return;
+
+    for (size_t w = 0; w < m_words; ++w) {
+        for (uint64_t bits = m_held[w]; bits != 0; bits &= bits - 1) {
+            const uint16_t button = w * 64 + __builtin_ctzll(bits);
+            if (m_presses[button].deadline > now) continue;
+
+            m_stats.timeouts++;
+            pass(button, now);
+            m_passed[w] |= 1ULL << (button % 64);
+        }
+    }
+
+    update_deadline();
+
+}
+
+
+uint64_t
+Chords::get_deadline() const
+{
+
+    return m_deadline;
+
+}
+
+
+const WP::Chords::Stats &
+Chords::get_stats() const
+{
+
+    return m_stats;
+
+}
+
+
+const WP::Histogram &
+Chords::get_delay() const
+{
+
+    return m_delay;
+
+}
+
+
+void
+Chords::match()
+{
+
+    // a chord is complete when all of its buttons are down and one of them is held back, the
+    // others may have been passed on already (a paddle held longer than the window), one AND
+    // and compare per word
+    const WP::MapChord *chords = m_map->get_chords();
+    const uint64_t *masks = m_map->get_chord_masks();
+
+    for (size_t c = 0, s = m_map->get_chord_count(); c < s; ++c) {
+        const uint64_t *mask = masks + c * m_words;
+
+        size_t w = 0;
+        bool held = false;
+        for (; w < m_words && ((m_held[w] | m_passed[w]) & mask[w]) == mask[w]; ++w) {
+            held |= (m_held[w] & mask[w]) != 0;
+        }
+        if (w < m_words || !held) continue;
+
+        // its held buttons are used up, so a later chord in the config that shares them does not
+        // match, passed on buttons keep their own ops until released
+        for (w = 0; w < m_words; ++w) {
+            const uint64_t used = m_held[w] & mask[w];
+            m_held[w] &= ~used;
+            m_used[w] |= used;
+            m_stats.suppressed += __builtin_popcountll(used);
+        }
+
+        m_active[c / 64] |= 1ULL << (c % 64);
+        m_stats.triggers++;
+        m_listener->onChordChanged(chords[c], true);
+    }
+
+}
+
+
+void
+Chords::pass(uint16_t button, uint64_t now)
+{
+
+    const WP::Chords::Press &press = m_presses[button];
+
+    m_held[button / 64] &= ~(1ULL << (button % 64));
+    m_delay.add(now > press.time ? now - press.time : 0);
+
+    m_listener->onChordButtonPassed(press.src, press.slot);
+
+}
+
+
+void
+Chords::release(size_t w, uint64_t bit)
+{
+
+    // releasing any button of a chord releases the chord, the other buttons stay used until released
+    const WP::MapChord *chords = m_map->get_chords();
+    const uint64_t *masks = m_map->get_chord_masks();
+    for (size_t a = 0, s = m_active.size(); a < s; ++a) {
+        for (uint64_t bits = m_active[a]; bits != 0; bits &= bits - 1) {
+            const size_t c = a * 64 + __builtin_ctzll(bits);
+            if (!(masks[c * m_words + w] & bit)) continue;
+
+            m_active[a] &= ~(1ULL << (c % 64));
+            m_listener->onChordChanged(chords[c], false);
+        }
+    }
+
+}
+
+
+void
+Chords::update_deadline()
+{
+
+    m_deadline = 0;
+    for (size_t w = 0; w < m_words; ++w) {
+        for (uint64_t bits = m_held[w]; bits != 0; bits &= bits - 1) {
+            const uint64_t deadline = m_presses[w * 64 + __builtin_ctzll(bits)].deadline;
+            if (m_deadline == 0 || deadline < m_deadline) m_deadline = deadline;
+        }
+    }
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,113 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef CHORDS_H
+#define CHORDS_H
+
+#include "histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+
+namespace WP {
+
+
+
+class Map;
+class Device;
+struct MapChord;
+class Chords
+{
+
+
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() { }
+        // the output button of a chord
+        virtual void onChordChanged(const WP::MapChord &chord, bool down) = 0;
+        // a held back press did not become part of a chord, the button's own ops run now
+        virtual void onChordButtonPassed(WP::Device *src, uint16_t slot) = 0;
+    };
+
+    struct Stats {
+        uint64_t triggers;   // chords pressed
+        uint64_t held;       // presses of chord buttons held back
+        uint64_t timeouts;   // held presses passed on when the window ran out
+        uint64_t taps;       // held presses passed on because the button was released first
+        uint64_t suppressed; // presses and releases that went into a chord instead
+    };
+
+
+    Chords();
+    ~Chords();
+
+    void init(const WP::Map *map);
+    void set_listener(WP::Chords::Listener *listener);
+
+    // false if the button's own ops must not run for this change
+    bool button_changed(WP::Device *src, uint16_t slot, uint16_t button, bool down, uint64_t time);
+    void expire(uint64_t now);
+
+    // earliest time a held press has to be passed on, 0 if none
+    uint64_t get_deadline() const;
+
+    const WP::Chords::Stats &get_stats() const;
+    const WP::Histogram &get_delay() const;
+
+
+private:
+    struct Press {
+        WP::Device *src;
+        uint16_t slot;
+        uint64_t time;
+        uint64_t deadline;
+    };
+
+    const WP::Map *m_map;
+    WP::Chords::Listener *m_listener;
+    size_t m_words;
+    std::vector<uint64_t> m_held;    // chord buttons down whose press is held back
+    std::vector<uint64_t> m_used;    // chord buttons down that are part of a pressed chord
+    std::vector<uint64_t> m_passed;  // chord buttons down whose press was passed on, they still count for chords
+    std::vector<uint64_t> m_active;  // pressed chords
+    std::vector<uint64_t> m_windows; // by chord button, the longest window of its chords in ns
+    std::vector<WP::Chords::Press> m_presses; // by chord button
+    uint64_t m_deadline;
+    WP::Chords::Stats m_stats;
+    WP::Histogram m_delay;
+
+    void match();
+    void pass(uint16_t button, uint64_t now);
+    void release(size_t w, uint64_t bit);
+    void update_deadline();
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // CHORDS_H
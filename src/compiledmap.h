@@ -0,0 +1,52 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef COMPILEDMAP_H
+#define COMPILEDMAP_H
+
+#include <stdint.h>
+
+
+
+namespace WP {
+
+
+
+class TargetDevice;
+
+// a map translated to C++ by wp-compile, linked into a specialized binary
+struct CompiledMap
+{
+
+    uint64_t fingerprint; // Map::get_fingerprint() of the config it was generated from
+    const char *config;
+    void (*dispatch)(WP::TargetDevice *target, uint32_t begin, int32_t value);
+
+};
+
+
+
+} // namespace WP
+
+
+// defined by the generated translation unit
+extern const WP::CompiledMap g_wp_compiled_map;
+
+
+
+#endif // COMPILEDMAP_H
@@ -0,0 +1,1056 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "config.h"
+#include "axis.h"
+#include "button.h"
+#include "map.h"
+#include "mapentry.h"
+#include "curve.h"
+#include "filter.h"
+#include "macro.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <cstring>
+#include <fstream>
+#include <streambuf>
+#include <linux/input.h>
+
+#include "3rdparty/json/json.hpp"
+
+
+enum wp_json_type {
+    JSON_TYPE_STRING,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_FLOAT
+};
+
+
+static bool
+json_get_value(const nlohmann::json &json, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
+{
+
+    if (json.is_null()) {
+        switch (type) {
+        case JSON_TYPE_STRING: (*(std::string*) ptr) = ""; break;
+        case JSON_TYPE_BOOL: (*(bool*) ptr) = false; break;
+        case JSON_TYPE_NUMBER: (*(int32_t*) ptr) = 0; break;
+        case JSON_TYPE_FLOAT: (*(double*) ptr) = 0.0; break;
+        default: return false;
+        }
+
+        return true;
+    }
+
+    switch (type) {
+    case JSON_TYPE_STRING:
+        if (json.type() != nlohmann::json::value_t::string) {
+            return false;
+        }
+        break;
+    case JSON_TYPE_BOOL:
+        if (json.type() != nlohmann::json::value_t::boolean) {
+            return false;
+        }
+        break;
+    case JSON_TYPE_NUMBER:
+        if (json.type() != nlohmann::json::value_t::number_integer && json.type() != nlohmann::json::value_t::number_unsigned) {
+            return false;
+        }
+
+        if (json.type() == nlohmann::json::value_t::number_integer) {
+            if (((int64_t) json) > max || ((int64_t) json) < min) {
+                return false;
+            }
+        } else {
+            if (max < 0) {
+                return false;
+            } else if (min >= 0 && ((uint64_t) json) < min) {
+                return false;
+            } else if (((uint64_t) json) > max) {
+                return false;
+            }
+        }
+        break;
+    case JSON_TYPE_FLOAT:
+        if (!json.is_number() || (double) json > max || (double) json < min) {
+            return false;
+        }
+
+        (*(double*) ptr) = json;
+        return true;
+    default: return false;
+    }
+
+    switch (json.type()) {
+    case nlohmann::json::value_t::string: (*(std::string*) ptr) = json; break;
+    case nlohmann::json::value_t::boolean: (*(bool*) ptr) = json; break;
+    case nlohmann::json::value_t::number_integer:
+    case nlohmann::json::value_t::number_unsigned: (*(int32_t*) ptr) = json; break;
+    default: return false;
+    }
+
+    return true;
+
+}
+
+
+static bool
+json_get_value_from_obj(const nlohmann::json &obj, const std::string &key, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
+{
+
+    const auto it = obj.find(key);
+    if (it == obj.end()) return false;
+    return json_get_value(*it, type, ptr, min, max);
+
+}
+
+
+static bool
+json_find_value(const nlohmann::json &obj, const std::vector<std::string> &path, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
+{
+
+    if (!obj.is_object()) return false;
+
+    nlohmann::json current_obj = obj;
+    for (size_t i = 0, s = path.size(); i < s; ++i) {
+        if (i == s - 1) {
+            return json_get_value_from_obj(current_obj, path[i], type, ptr, min, max);
+        } else {
+            const auto it = current_obj.find(path[i]);
+            if (it == current_obj.end()) return false;
+            if (!(*it).is_object()) return false;
+            current_obj = *it;
+        }
+    }
+
+    return false;
+
+}
+
+
+template <typename T>
+static T *
+get_event_source_by_code(const std::vector<T*> &vec, uint16_t code)
+{
+
+    for (size_t i = 0, s = vec.size(); i < s; ++i) {
+        T *e = vec[i];
+        if (e->get_code() == code) return e;
+    }
+    return nullptr;
+
+}
+
+
+template <typename T>
+static T *
+get_event_source_by_name(const std::vector<T*> &vec, const std::string &name)
+{
+
+    for (size_t i = 0, s = vec.size(); i < s; ++i) {
+        T *e = vec[i];
+        if (e->get_name().compare(name) == 0) return e;
+    }
+    return nullptr;
+
+}
+
+
+
+static bool
+parse_filter_stage(const nlohmann::json &stage_obj, const WP::Axis *axis, WP::Filter *filter)
+{
+
+    std::string type;
+    if (!json_find_value(stage_obj, { "type" }, JSON_TYPE_STRING, (void*) &type)) {
+        printf("missing or invalid filter type:\n%s\n", stage_obj.dump().c_str());
+        return false;
+    }
+
+    if (type == "ema") {
+        double alpha;
+        if (!json_find_value(stage_obj, { "alpha" }, JSON_TYPE_FLOAT, (void*) &alpha, 0, 1) || !filter->add_ema(alpha)) {
+            printf("invalid ema filter, needs 0 < alpha <= 1:\n%s\n", stage_obj.dump().c_str());
+            return false;
+        }
+    } else if (type == "one_euro") {
+        double min_cutoff = 1.0;
+        double beta = 0.0;
+        double d_cutoff = 1.0;
+        const int64_t range = (int64_t) axis->get_max() - axis->get_min();
+
+        if ((stage_obj.find("min_cutoff") != stage_obj.end() && !json_find_value(stage_obj, { "min_cutoff" }, JSON_TYPE_FLOAT, (void*) &min_cutoff, 0, 1000)) ||
+                (stage_obj.find("beta") != stage_obj.end() && !json_find_value(stage_obj, { "beta" }, JSON_TYPE_FLOAT, (void*) &beta, 0, 1000)) ||
+                (stage_obj.find("d_cutoff") != stage_obj.end() && !json_find_value(stage_obj, { "d_cutoff" }, JSON_TYPE_FLOAT, (void*) &d_cutoff, 0, 1000)) ||
+                range <= 0 || !filter->add_one_euro(min_cutoff, beta, d_cutoff, range))
+        {
+            printf("invalid one_euro filter, needs min_cutoff > 0, beta >= 0 and d_cutoff > 0:\n%s\n", stage_obj.dump().c_str());
+            return false;
+        }
+    } else if (type == "median3") {
+        filter->add_median3();
+    } else {
+        printf("unknown filter type \"%s\"\n", type.c_str());
+        return false;
+    }
+
+    return true;
+
+}
+
+
+static WP::Filter *
+parse_filter(const nlohmann::json &filter_obj, const WP::Axis *axis, WP::Arena *arena)
+{
+
+    // one stage or a list of stages applied in order
+    std::vector<nlohmann::json> stages;
+    if (filter_obj.is_array()) {
+        stages.assign(filter_obj.begin(), filter_obj.end());
+    } else {
+        stages.push_back(filter_obj);
+    }
+
+    if (stages.empty() || stages.size() > WP_FILTER_STAGES) {
+        printf("a filter needs 1 to %d stages:\n%s\n", WP_FILTER_STAGES, filter_obj.dump().c_str());
+        return nullptr;
+    }
+
+    WP::Filter *filter = arena->create<WP::Filter>();
+    for (size_t i = 0, s = stages.size(); i < s; ++i) {
+        if (!parse_filter_stage(stages[i], axis, filter)) return nullptr;
+    }
+
+    return filter;
+
+}
+
+
+static bool
+parse_axes(nlohmann::json &dev_obj, std::vector<WP::Axis*> *axes, WP::Arena *arena, bool input)
+{
+
+    const auto _axes_array = dev_obj.find("axes");
+    if (_axes_array == dev_obj.end()) return false;
+
+    const auto axes_array = *_axes_array;
+    if (axes_array.is_null()) return true;
+    if (!axes_array.is_array()) {
+        printf("invalid or missing axes element\n");
+        return false;
+    }
+
+    for (auto it = axes_array.begin(); it != axes_array.end(); ++it) {
+        const auto axis_obj = *it;
+
+        std::string name;
+        int32_t code;
+        int32_t min;
+        int32_t max;
+        bool invert;
+
+
+        if (!json_find_value(axis_obj, { "name" }, JSON_TYPE_STRING, (void*) &name) ||
+                !json_find_value(axis_obj, { "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, ABS_MAX) ||
+                !json_find_value(axis_obj, { "min" }, JSON_TYPE_NUMBER, (void*) &min, INT32_MIN, INT32_MAX) ||
+                !json_find_value(axis_obj, { "max" }, JSON_TYPE_NUMBER, (void*) &max, INT32_MIN, INT32_MAX) ||
+                !json_find_value(axis_obj, { "invert" }, JSON_TYPE_BOOL, (void*) &invert))
+        {
+            printf("invalid axis:\n%s\n", axis_obj.dump().c_str());
+            return false;
+        }
+
+
+        if (get_event_source_by_code(*axes, code) != nullptr) {
+            printf("duplicate axis code %d:\n%s\n", code, axis_obj.dump().c_str());
+            return false;
+        }
+
+
+        WP::Axis *axis = arena->create<WP::Axis>();
+        axis->set_code(code);
+        axis->set_min(min);
+        axis->set_max(max);
+        axis->set_name(name);
+        axis->set_invert(invert);
+
+        if (axis_obj.find("filter") != axis_obj.end()) {
+            if (!input) {
+                printf("filters are only supported on input axes:\n%s\n", axis_obj.dump().c_str());
+                return false;
+            }
+
+            WP::Filter *filter = parse_filter(*axis_obj.find("filter"), axis, arena);
+            if (filter == nullptr) return false;
+            axis->set_filter(filter);
+        }
+
+        axes->push_back(axis);
+    }
+
+    return true;
+
+}
+
+
+static bool
+parse_buttons(nlohmann::json &dev_obj, std::vector<WP::Button*> *buttons, WP::Arena *arena)
+{
+
+    const auto _button_array = dev_obj.find("buttons");
+    if (_button_array == dev_obj.end()) return false;
+
+    const auto button_array = *_button_array;
+    if (button_array.is_null()) return true;
+    if (!button_array.is_array()) {
+        printf("invalid or missing buttons element\n");
+        return false;
+    }
+
+    for (auto it = button_array.begin(); it != button_array.end(); ++it) {
+        const auto button_obj = *it;
+
+        std::string name;
+        int32_t code;
+
+        if (!json_find_value(button_obj, { "name" }, JSON_TYPE_STRING, (void*) &name) ||
+                !json_find_value(button_obj, { "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, KEY_MAX))
+        {
+            printf("invalid button:\n%s\n", button_obj.dump().c_str());
+            return false;
+        }
+
+        if (get_event_source_by_code(*buttons, code) != nullptr) {
+            printf("duplicate button code %d:\n%s\n", code, button_obj.dump().c_str());
+            return false;
+        }
+
+        WP::Button *button = arena->create<WP::Button>();
+        button->set_code(code);
+        button->set_name(name);
+
+        buttons->push_back(button);
+    }
+
+    return true;
+
+}
+
+
+
+static bool
+parse_device(nlohmann::json &dev_obj, WP::DeviceConfig *dev, WP::Arena *arena, bool input)
+{
+
+    if (!dev_obj.is_object() ||
+            !json_find_value(dev_obj, { "name" }, JSON_TYPE_STRING, (void*) &dev->name) ||
+            !json_find_value(dev_obj, { "vendor" }, JSON_TYPE_NUMBER, (void*) &dev->vendor, 0, INT32_MAX) ||
+            !json_find_value(dev_obj, { "product" }, JSON_TYPE_NUMBER, (void*) &dev->product, 0, INT32_MAX) ||
+            !json_find_value(dev_obj, { "version" }, JSON_TYPE_NUMBER, (void*) &dev->version, 0, INT32_MAX))
+    {
+        return false;
+    }
+
+    // optional, to tell apart identical devices
+    json_find_value(dev_obj, { "phys" }, JSON_TYPE_STRING, (void*) &dev->phys);
+    json_find_value(dev_obj, { "uniq" }, JSON_TYPE_STRING, (void*) &dev->uniq);
+
+    return parse_buttons(dev_obj, &dev->buttons, arena) && parse_axes(dev_obj, &dev->axes, arena, input);
+
+}
+
+
+static bool
+get_device_info(nlohmann::json &json, WP::Config *config)
+{
+
+    const auto input = json.find("input");
+    const auto output = json.find("output");
+    if (input == json.end() || output == json.end()) {
+        return false;
+    }
+
+
+    // either a single input device or an array of devices feeding the same output
+    if ((*input).is_array()) {
+        for (auto it = (*input).begin(); it != (*input).end(); ++it) {
+            WP::DeviceConfig *in = config->arena.create<WP::DeviceConfig>();
+            config->inputs.push_back(in);
+
+            if (!parse_device(*it, in, &config->arena, true)) {
+                printf("invalid input device:\n%s\n", (*it).dump().c_str());
+                return false;
+            }
+
+            // map entries resolve to the event sources, they keep which device they came from
+            const uint16_t index = config->inputs.size() - 1;
+            for (WP::Axis *axis : in->axes) axis->set_device(index);
+            for (WP::Button *button : in->buttons) button->set_device(index);
+        }
+    } else {
+        WP::DeviceConfig *in = config->arena.create<WP::DeviceConfig>();
+        config->inputs.push_back(in);
+
+        if (!parse_device(*input, in, &config->arena, true)) {
+            printf("invalid input device\n");
+            return false;
+        }
+    }
+
+    if (config->inputs.size() < 1) {
+        printf("missing input device\n");
+        return false;
+    }
+
+    // map entries pick an input by name, phys or uniq, one of them has to differ
+    for (size_t i = 0, s = config->inputs.size(); i < s; ++i) {
+        for (size_t j = i + 1; j < s; ++j) {
+            const WP::DeviceConfig *a = config->inputs[i];
+            const WP::DeviceConfig *b = config->inputs[j];
+            if (a->name == b->name && a->phys == b->phys && a->uniq == b->uniq) {
+                printf("input devices named \"%s\" need a different name, phys or uniq\n", a->name.c_str());
+                return false;
+            }
+        }
+    }
+
+
+    if (!parse_device(*output, &config->output, &config->arena, false)) {
+        printf("invalid output device\n");
+        return false;
+    }
+
+    return true;
+
+}
+
+
+static WP::EventSource *
+find_event_source(const WP::DeviceConfig *dev, bool button, bool by_name, const std::string &name, int32_t code)
+{
+
+    if (button) {
+        if (by_name) return get_event_source_by_name(dev->buttons, name);
+        return get_event_source_by_code(dev->buttons, code);
+    }
+
+    if (by_name) return get_event_source_by_name(dev->axes, name);
+    return get_event_source_by_code(dev->axes, code);
+
+}
+
+
+static WP::EventSource *
+parse_map_entry_event_source(const nlohmann::json &entry, bool src, const WP::Config *config)
+{
+
+    WP::EventSource *ret = nullptr;
+    const std::string key = src ? "src" : "target";
+    std::string name;
+    std::string type;
+    std::string device;
+    int32_t code = 0;
+
+
+    if (!json_find_value(entry, { key, "type" }, JSON_TYPE_STRING, (void*) &type)) {
+        printf("missing %s type:\n%s\n", key.c_str(), entry.dump().c_str());
+        return nullptr;
+    } else if (type.compare("button") != 0 && type.compare("axis") != 0) {
+        printf("invalid %s type: %s\n%s\n", key.c_str(), type.c_str(), entry.dump().c_str());
+        return nullptr;
+    }
+
+
+    const bool found_code = json_find_value(entry, { key, "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, INT32_MAX);
+    const bool found_name = json_find_value(entry, { key, "name" }, JSON_TYPE_STRING, (void*) &name);
+    const bool found_device = src && json_find_value(entry, { key, "device" }, JSON_TYPE_STRING, (void*) &device);
+    const bool button = type.compare("button") == 0;
+
+
+    if (!found_code && !found_name) {
+        printf("missing %s code or name:\n%s\n", key.c_str(), entry.dump().c_str());
+        return nullptr;
+    }
+
+
+    if (src) {
+        bool found_input = false;
+        for (size_t i = 0, s = config->inputs.size(); i < s; ++i) {
+            const WP::DeviceConfig *in = config->inputs[i];
+            if (found_device && in->name.compare(device) != 0 &&
+                    (in->phys.empty() || in->phys.compare(device) != 0) &&
+                    (in->uniq.empty() || in->uniq.compare(device) != 0))
+            {
+                continue;
+            }
+            found_input = true;
+
+            WP::EventSource *e = find_event_source(in, button, found_name, name, code);
+            if (e == nullptr) continue;
+
+            if (ret != nullptr) {
+                printf("ambiguous %s %s, please set the input device:\n%s\n", key.c_str(), type.c_str(), entry.dump().c_str());
+                return nullptr;
+            }
+            ret = e;
+        }
+
+        if (!found_input) {
+            printf("invalid %s device: %s\n%s\n", key.c_str(), device.c_str(), entry.dump().c_str());
+            return nullptr;
+        }
+    } else {
+        ret = find_event_source(&config->output, button, found_name, name, code);
+    }
+
+
+    if (ret == nullptr) {
+        if (found_name) {
+            printf("invalid %s %s name: %s\n%s\n", key.c_str(), type.c_str(), name.c_str(), entry.dump().c_str());
+        } else {
+            printf("invalid %s %s code: %d\n%s\n", key.c_str(), type.c_str(), code, entry.dump().c_str());
+        }
+    }
+
+    return ret;
+
+}
+
+
+static WP::Curve *
+parse_curve(const nlohmann::json &curve_obj, WP::Arena *arena)
+{
+
+    if (!curve_obj.is_object()) {
+        printf("invalid curve:\n%s\n", curve_obj.dump().c_str());
+        return nullptr;
+    }
+
+    double deadzone = 0.0;
+    double saturation = 1.0;
+    double gamma = 1.0;
+    bool center = false;
+    bool spline = false;
+    std::vector<WP::Curve::Point> points;
+
+    if ((curve_obj.find("deadzone") != curve_obj.end() && !json_find_value(curve_obj, { "deadzone" }, JSON_TYPE_FLOAT, (void*) &deadzone, 0, 1)) ||
+            (curve_obj.find("saturation") != curve_obj.end() && !json_find_value(curve_obj, { "saturation" }, JSON_TYPE_FLOAT, (void*) &saturation, 0, 1)) ||
+            (curve_obj.find("gamma") != curve_obj.end() && !json_find_value(curve_obj, { "gamma" }, JSON_TYPE_FLOAT, (void*) &gamma, 0, 100)) ||
+            (curve_obj.find("center") != curve_obj.end() && !json_find_value(curve_obj, { "center" }, JSON_TYPE_BOOL, (void*) &center)) ||
+            (curve_obj.find("spline") != curve_obj.end() && !json_find_value(curve_obj, { "spline" }, JSON_TYPE_BOOL, (void*) &spline)))
+    {
+        printf("invalid curve value:\n%s\n", curve_obj.dump().c_str());
+        return nullptr;
+    }
+
+    if (deadzone >= saturation || gamma <= 0.0) {
+        printf("invalid curve: deadzone must be below saturation and gamma above 0\n%s\n", curve_obj.dump().c_str());
+        return nullptr;
+    }
+
+    const auto _points = curve_obj.find("points");
+    if (_points != curve_obj.end()) {
+        if (!(*_points).is_array() || (*_points).size() < 2) {
+            printf("invalid curve points, need at least two [x, y] pairs:\n%s\n", curve_obj.dump().c_str());
+            return nullptr;
+        }
+
+        for (const auto &point : *_points) {
+            double x;
+            double y;
+
+            if (!point.is_array() || point.size() != 2 ||
+                    !json_get_value(point[0], JSON_TYPE_FLOAT, (void*) &x, 0, 1) ||
+                    !json_get_value(point[1], JSON_TYPE_FLOAT, (void*) &y, 0, 1))
+            {
+                printf("invalid curve point, x and y must be in 0..1:\n%s\n", point.dump().c_str());
+                return nullptr;
+            }
+
+            if (!points.empty() && x <= points.back().first) {
+                printf("invalid curve points, x must be increasing:\n%s\n", curve_obj.dump().c_str());
+                return nullptr;
+            }
+
+            points.push_back(WP::Curve::Point(x, y));
+        }
+    }
+
+    WP::Curve *curve = arena->create<WP::Curve>();
+    curve->set_deadzone(deadzone);
+    curve->set_saturation(saturation);
+    curve->set_gamma(gamma);
+    curve->set_center(center);
+    if (!points.empty()) curve->set_points(points, spline);
+
+    return curve;
+
+}
+
+
+static bool
+parse_heartbeat(const nlohmann::json &entry_obj, WP::MapEntry *entry)
+{
+
+    if (entry_obj.find("heartbeat") == entry_obj.end()) return true;
+
+    bool heartbeat;
+    if (!json_find_value(entry_obj, { "heartbeat" }, JSON_TYPE_BOOL, (void*) &heartbeat)) {
+        printf("invalid map entry heartbeat:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    entry->set_heartbeat(heartbeat);
+    return true;
+
+}
+
+
+static bool
+parse_split(const nlohmann::json &src_obj, WP::MapEntry *entry)
+{
+
+    // optional part of the source axis that covers the whole target axis
+    if (!src_obj.is_object() || src_obj.find("range") == src_obj.end()) return true;
+
+    int32_t range_start;
+    int32_t range_end;
+
+    if (!json_find_value(src_obj, { "range", "start" }, JSON_TYPE_NUMBER, (void*) &range_start, INT32_MIN, INT32_MAX) ||
+            !json_find_value(src_obj, { "range", "end" }, JSON_TYPE_NUMBER, (void*) &range_end, INT32_MIN, INT32_MAX) ||
+            range_start == range_end)
+    {
+        printf("invalid axis to axis range, needs start != end:\n%s\n", src_obj.dump().c_str());
+        return false;
+    }
+
+    entry->set_split(range_start, range_end);
+    return true;
+
+}
+
+
+static WP::MapEntry *
+parse_map_entry(const nlohmann::json &entry_obj, WP::Config *config)
+{
+
+    if (!entry_obj.is_object()) {
+        printf("invalid map entry:\n%s\n", entry_obj.dump().c_str());
+        return nullptr;
+    }
+
+
+    WP::EventSource *src = parse_map_entry_event_source(entry_obj, true, config);
+    WP::EventSource *target = parse_map_entry_event_source(entry_obj, false, config);
+    WP::MapEntry *entry = nullptr;
+
+    if (src == nullptr || target == nullptr) {
+        goto failed;
+    }
+
+    entry = config->arena.create<WP::MapEntry>(src, target);
+
+    if (!parse_heartbeat(entry_obj, entry)) {
+        goto failed;
+    }
+
+    if (src->get_type() == WP::EventSource::TYPE_AXIS) {
+        if (target->get_type() == WP::EventSource::TYPE_BUTTON) {
+            int32_t range_start;
+            int32_t range_end;
+
+            if (!json_find_value(entry_obj, { "src", "range", "start" }, JSON_TYPE_NUMBER, (void*) &range_start, INT32_MIN, INT32_MAX) ||
+                    !json_find_value(entry_obj, { "src", "range", "end" }, JSON_TYPE_NUMBER, (void*) &range_end, INT32_MIN, INT32_MAX))
+            {
+                printf("missing or invalid axis to button range:\n%s\n", entry_obj.dump().c_str());
+                goto failed;
+            }
+
+            if (range_start > range_end) {
+                printf("invalid axis to button range: start > end\n%s\n", entry_obj.dump().c_str());
+                goto failed;
+            }
+
+            entry->set_range(range_start, range_end);
+        } else {
+            if (!parse_split(*entry_obj.find("src"), entry)) {
+                goto failed;
+            }
+
+            if (entry_obj.find("curve") != entry_obj.end()) {
+                WP::Curve *curve = parse_curve(*entry_obj.find("curve"), &config->arena);
+                if (curve == nullptr) {
+                    goto failed;
+                }
+
+                entry->set_curve(curve);
+            }
+        }
+    } else if (src->get_type() == WP::EventSource::TYPE_BUTTON) {
+        if (target->get_type() == WP::EventSource::TYPE_AXIS) {
+            int32_t value_released;
+            int32_t value_pressed;
+
+            if (!json_find_value(entry_obj, { "target", "values", "released" }, JSON_TYPE_NUMBER, (void*) &value_released, INT32_MIN, INT32_MAX) ||
+                    !json_find_value(entry_obj, { "target", "values", "pressed" }, JSON_TYPE_NUMBER, (void*) &value_pressed, INT32_MIN, INT32_MAX))
+            {
+                printf("missing or invalid button to axis values:\n%s\n", entry_obj.dump().c_str());
+                goto failed;
+            }
+
+            entry->set_values(value_released, value_pressed);
+        }
+    }
+
+    return entry;
+
+failed:
+    return nullptr;
+
+}
+
+
+static bool
+parse_combine(const nlohmann::json &entry_obj, uint16_t group, WP::Map *map, WP::Config *config)
+{
+
+    std::string name;
+    uint8_t mode;
+
+    if (!json_find_value(entry_obj, { "combine" }, JSON_TYPE_STRING, (void*) &name)) {
+        printf("invalid combine:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    } else if (name == "sum") {
+        mode = WP::MapCombine::SUM;
+    } else if (name == "difference") {
+        mode = WP::MapCombine::DIFFERENCE;
+    } else if (name == "max") {
+        mode = WP::MapCombine::MAX;
+    } else {
+        printf("unknown combine \"%s\", use sum, difference or max\n", name.c_str());
+        return false;
+    }
+
+    const auto _src_array = entry_obj.find("src");
+    if (_src_array == entry_obj.end() || !(*_src_array).is_array() ||
+            (*_src_array).size() < 2 || (*_src_array).size() > WP_COMBINE_MAX_INPUTS)
+    {
+        printf("a combine needs 2 to %d source axes in \"src\":\n%s\n", WP_COMBINE_MAX_INPUTS, entry_obj.dump().c_str());
+        return false;
+    }
+
+    WP::EventSource *target = parse_map_entry_event_source(entry_obj, false, config);
+    if (target == nullptr) return false;
+    if (target->get_type() != WP::EventSource::TYPE_AXIS) {
+        printf("a combine needs a target axis:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    // one entry per input, all of them in the same group
+    for (const auto &src_obj : *_src_array) {
+        nlohmann::json input_obj;
+        input_obj["src"] = src_obj;
+
+        WP::EventSource *src = parse_map_entry_event_source(input_obj, true, config);
+        if (src == nullptr) return false;
+        if (src->get_type() != WP::EventSource::TYPE_AXIS) {
+            printf("combine sources must be axes:\n%s\n", src_obj.dump().c_str());
+            return false;
+        }
+
+        WP::MapEntry *entry = config->arena.create<WP::MapEntry>(src, target);
+        if (!parse_heartbeat(entry_obj, entry) || !parse_split(src_obj, entry)) {
+            return false;
+        }
+
+        entry->set_combine(mode, group);
+        map->add(entry);
+    }
+
+    return true;
+
+}
+
+
+static bool
+parse_chord(const nlohmann::json &entry_obj, uint16_t group, WP::Map *map, WP::Config *config)
+{
+
+    const auto _chord_obj = entry_obj.find("chord");
+    int32_t window = WP_CHORD_WINDOW_MS;
+
+    if (!(*_chord_obj).is_object()) {
+        printf("invalid chord, use \"chord\": { \"window\": ms }:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    if ((*_chord_obj).find("window") != (*_chord_obj).end() &&
+            !json_find_value(*_chord_obj, { "window" }, JSON_TYPE_NUMBER, (void*) &window, 1, 10000))
+    {
+        printf("invalid chord window, needs 1 to 10000 ms:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    const auto _src_array = entry_obj.find("src");
+    if (_src_array == entry_obj.end() || !(*_src_array).is_array() ||
+            (*_src_array).size() < 2 || (*_src_array).size() > WP_CHORD_MAX_BUTTONS)
+    {
+        printf("a chord needs 2 to %d source buttons in \"src\":\n%s\n", WP_CHORD_MAX_BUTTONS, entry_obj.dump().c_str());
+        return false;
+    }
+
+    WP::EventSource *target = parse_map_entry_event_source(entry_obj, false, config);
+    if (target == nullptr) return false;
+    if (target->get_type() != WP::EventSource::TYPE_BUTTON) {
+        printf("a chord needs a target button:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    // one entry per button, all of them in the same group
+    for (const auto &src_obj : *_src_array) {
+        nlohmann::json input_obj;
+        input_obj["src"] = src_obj;
+
+        WP::EventSource *src = parse_map_entry_event_source(input_obj, true, config);
+        if (src == nullptr) return false;
+        if (src->get_type() != WP::EventSource::TYPE_BUTTON) {
+            printf("chord sources must be buttons:\n%s\n", src_obj.dump().c_str());
+            return false;
+        }
+
+        WP::MapEntry *entry = config->arena.create<WP::MapEntry>(src, target);
+        if (!parse_heartbeat(entry_obj, entry)) {
+            return false;
+        }
+
+        entry->set_chord(group, window);
+        map->add(entry);
+    }
+
+    return true;
+
+}
+
+
+static bool
+parse_macro_step(const nlohmann::json &step_obj, const WP::Config *config, WP::Macro *macro, uint32_t *delay)
+{
+
+    if (!step_obj.is_object() || step_obj.size() < 1) {
+        printf("invalid macro step:\n%s\n", step_obj.dump().c_str());
+        return false;
+    }
+
+    // delays add up until the next step
+    if (step_obj.find("delay") != step_obj.end()) {
+        int32_t ms;
+        if (step_obj.size() != 1 || !json_find_value(step_obj, { "delay" }, JSON_TYPE_NUMBER, (void*) &ms, 0, 60000)) {
+            printf("invalid macro delay, needs 0 to 60000 ms:\n%s\n", step_obj.dump().c_str());
+            return false;
+        }
+
+        *delay += ms;
+        return true;
+    }
+
+
+    std::string name;
+    uint8_t type;
+
+    if (json_find_value(step_obj, { "press" }, JSON_TYPE_STRING, (void*) &name)) {
+        type = WP::Macro::Step::PRESS;
+    } else if (json_find_value(step_obj, { "release" }, JSON_TYPE_STRING, (void*) &name)) {
+        type = WP::Macro::Step::RELEASE;
+    } else if (json_find_value(step_obj, { "axis" }, JSON_TYPE_STRING, (void*) &name)) {
+        type = WP::Macro::Step::AXIS;
+    } else {
+        printf("unknown macro step, use press, release, axis or delay:\n%s\n", step_obj.dump().c_str());
+        return false;
+    }
+
+    const bool axis = type == WP::Macro::Step::AXIS;
+    WP::EventSource *target = find_event_source(&config->output, !axis, true, name, 0);
+    if (target == nullptr) {
+        printf("invalid macro target %s name: %s\n%s\n", axis ? "axis" : "button", name.c_str(), step_obj.dump().c_str());
+        return false;
+    }
+
+    int32_t value = 0;
+    if (axis) {
+        const WP::Axis *target_axis = (const WP::Axis*) target;
+        if (!json_find_value(step_obj, { "value" }, JSON_TYPE_NUMBER, (void*) &value, target_axis->get_min(), target_axis->get_max())) {
+            printf("missing or invalid macro axis value, needs %d to %d:\n%s\n",
+                   target_axis->get_min(), target_axis->get_max(), step_obj.dump().c_str());
+            return false;
+        }
+    }
+
+    macro->add_step(type, target, value, *delay);
+    *delay = 0;
+    return true;
+
+}
+
+
+static bool
+parse_macro(const nlohmann::json &entry_obj, WP::Map *map, WP::Config *config)
+{
+
+    const auto _steps_array = entry_obj.find("macro");
+    if (!(*_steps_array).is_array() || (*_steps_array).size() > WP_MACRO_MAX_STEPS) {
+        printf("a macro needs a list of up to %d steps:\n%s\n", WP_MACRO_MAX_STEPS, entry_obj.dump().c_str());
+        return false;
+    }
+
+    WP::EventSource *src = parse_map_entry_event_source(entry_obj, true, config);
+    if (src == nullptr) return false;
+    if (src->get_type() != WP::EventSource::TYPE_BUTTON) {
+        printf("a macro needs a source button:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    WP::Macro *macro = config->arena.create<WP::Macro>();
+    uint32_t delay = 0;
+    for (const auto &step_obj : *_steps_array) {
+        if (!parse_macro_step(step_obj, config, macro, &delay)) return false;
+    }
+
+    if (macro->get_steps().size() < 1) {
+        printf("a macro needs at least one press, release or axis step:\n%s\n", entry_obj.dump().c_str());
+        return false;
+    }
+
+    // the first target only has to be a valid one, the map resolves every step
+    WP::MapEntry *entry = config->arena.create<WP::MapEntry>(src, macro->get_steps()[0].target);
+    entry->set_macro(macro);
+    map->add(entry);
+    return true;
+
+}
+
+
+static bool
+parse_map(nlohmann::json &json, WP::Map *map, WP::Config *config)
+{
+
+    const auto _map_array = json.find("map");
+    if (_map_array == json.end()) {
+        printf("missing map element\n");
+        return false;
+    }
+
+    const auto map_array = *_map_array;
+    if (!map_array.is_array()) {
+        printf("invalid map element\n");
+        return false;
+    }
+
+
+    uint16_t combines = 0;
+    uint16_t chords = 0;
+    for (auto it = map_array.begin(); it != map_array.end(); ++it) {
+        if ((*it).is_object() && (*it).find("combine") != (*it).end()) {
+            if (!parse_combine(*it, combines++, map, config)) return false;
+            continue;
+        }
+
+        if ((*it).is_object() && (*it).find("chord") != (*it).end()) {
+            if (!parse_chord(*it, chords++, map, config)) return false;
+            continue;
+        }
+
+        if ((*it).is_object() && (*it).find("macro") != (*it).end()) {
+            if (!parse_macro(*it, map, config)) return false;
+            continue;
+        }
+
+        WP::MapEntry *entry = parse_map_entry(*it, config);
+        if (entry == nullptr) return false;
+        map->add(entry);
+    }
+
+    return true;
+
+}
+
+
+static bool
+parse_config(const char *file, WP::Map *map, WP::Config *config)
+{
+
+    std::ifstream ifs(file);
+    std::string str;
+
+    if (ifs.fail()) {
+        printf("\"%s\": %s\n", file, strerror(errno));
+        return false;
+    }
+
+    ifs.seekg(0, std::ios::end);
+    if (ifs.tellg() < 1) {
+        printf("empty config...\n");
+        return false;
+    }
+    str.reserve(ifs.tellg());
+    ifs.seekg(0, std::ios::beg);
+
+    str.assign((std::istreambuf_iterator<char>(ifs)),
+                std::istreambuf_iterator<char>());
+    if (str.length() < 1) {
+        printf("empty config\n");
+        return false;
+    }
+
+
+    try {
+        auto json = nlohmann::json::parse(str);
+        if (!json.is_object()) {
+            return false;
+        }
+
+        if (!get_device_info(json, config)) return false;
+        if (!parse_map(json, map, config)) return false;
+    } catch (const std::exception &e) {
+        printf("%s\n", e.what());
+        return false;
+    }
+
+    return true;
+
+}
+
+
+
+namespace WP {
+
+
+
+bool
+Config::load(const char *file, WP::Map *map)
+{
+
+    return parse_config(file, map, this);
+
+}
+
+
+
+} // namespace WP
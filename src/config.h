@@ -0,0 +1,68 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace WP {
+
+
+class Axis;
+class Button;
+class Map;
+class DeviceConfig {
+public:
+    DeviceConfig() { }
+
+    std::string name;
+    std::string phys;
+    std::string uniq;
+    int32_t vendor;
+    int32_t product;
+    int32_t version;
+    std::vector<WP::Axis*> axes;
+    std::vector<WP::Button*> buttons;
+
+};
+
+
+class Config {
+public:
+    Config() { }
+
+    bool load(const char *file, WP::Map *map);
+
+    WP::Arena arena; // owns everything built from the config, must outlive the devices
+    std::vector<WP::DeviceConfig*> inputs;
+    WP::DeviceConfig output;
+
+};
+
+
+} // namespace WP
+
+
+
+#endif // CONFIG_H
@@ -0,0 +1,217 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#include "curve.h"
+#include "axis.h"
+
+#include <assert.h>
+#include <math.h>
+
+
+
+static double
+clamp(double x, double min, double max)
+{
+
+    return x < min ? min : (x > max ? max : x);
+
+}
+
+
+
+namespace WP {
+
+
+
+Curve::Curve()
+    : m_deadzone(0.0),
+      m_saturation(1.0),
+      m_gamma(1.0),
+      m_center(false)
+{
+
+}
+
+
+Curve::~Curve()
+{
+
+}
+
+
+void
+Curve::set_deadzone(double deadzone)
+{
+
+    m_deadzone = deadzone;
+
+}
+
+
+void
+Curve::set_saturation(double saturation)
+{
+
+    m_saturation = saturation;
+
+}
+
+
+void
+Curve::set_gamma(double gamma)
+{
+
+    m_gamma = gamma;
+
+}
+
+
+void
+Curve::set_center(bool center)
+{
+
+    m_center = center;
+
+}
+
+
+void
+Curve::set_points(const std::vector<WP::Curve::Point> &points, bool spline)
+{
+
+    assert(points.size() >= 2);
+
+    m_points = points;
+    m_tangents.clear();
+    if (!spline) return;
+
+    // Fritsch-Carlson tangents, the spline does not overshoot between monotone points
+    const size_t n = points.size();
+    std::vector<double> slopes(n - 1);
+    for (size_t i = 0; i + 1 < n; ++i) {
+        slopes[i] = (points[i + 1].second - points[i].second) / (points[i + 1].first - points[i].first);
+    }
+
+    m_tangents.resize(n);
+    m_tangents[0] = slopes[0];
+    m_tangents[n - 1] = slopes[n - 2];
+    for (size_t i = 1; i + 1 < n; ++i) {
+        m_tangents[i] = slopes[i - 1] * slopes[i] <= 0.0 ? 0.0 : (slopes[i - 1] + slopes[i]) / 2.0;
+    }
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+        if (slopes[i] == 0.0) {
+            m_tangents[i] = m_tangents[i + 1] = 0.0;
+            continue;
+        }
+
+        const double a = m_tangents[i] / slopes[i];
+        const double b = m_tangents[i + 1] / slopes[i];
+        const double h = a * a + b * b;
+        if (h > 9.0) {
+            const double t = 3.0 / sqrt(h);
+            m_tangents[i] = t * a * slopes[i];
+            m_tangents[i + 1] = t * b * slopes[i];
+        }
+    }
+
+}
+
+
+double
+Curve::evaluate(double x) const
+{
+
+    x = clamp(x, 0.0, 1.0);
+    if (!m_center) return shape(x);
+
+    // steering: shape the distance from the center, keep the side
+    const double d = 2.0 * x - 1.0;
+    const double y = shape(fabs(d));
+    return d < 0.0 ? 0.5 - 0.5 * y : 0.5 + 0.5 * y;
+
+}
+
+
+void
+Curve::sample(bool src_invert, const WP::Axis *target, int32_t *knots) const
+{
+
+    const double target_range = (double) target->get_max() - target->get_min();
+
+    for (int i = 0; i <= WP_CURVE_SEGMENTS; ++i) {
+        double x = (double) i / WP_CURVE_SEGMENTS;
+        if (src_invert) x = 1.0 - x;
+
+        double y = evaluate(x);
+        if (target->get_invert()) y = 1.0 - y;
+
+        knots[i] = (int32_t) llround(target->get_min() + y * target_range);
+    }
+
+}
+
+
+double
+Curve::shape(double x) const
+{
+
+    if (x <= m_deadzone) return 0.0;
+    if (x >= m_saturation) x = 1.0;
+    else x = (x - m_deadzone) / (m_saturation - m_deadzone);
+
+    if (m_gamma != 1.0) x = pow(x, m_gamma);
+    if (!m_points.empty()) x = interpolate(x);
+
+    return clamp(x, 0.0, 1.0);
+
+}
+
+
+double
+Curve::interpolate(double x) const
+{
+
+    const size_t n = m_points.size();
+    if (x <= m_points[0].first) return m_points[0].second;
+    if (x >= m_points[n - 1].first) return m_points[n - 1].second;
+
+    size_t i = 0;
+    while (x > m_points[i + 1].first) ++i;
+
+    const WP::Curve::Point &p0 = m_points[i];
+    const WP::Curve::Point &p1 = m_points[i + 1];
+    const double h = p1.first - p0.first;
+    const double t = (x - p0.first) / h;
+
+    if (m_tangents.empty()) {
+        return p0.second + t * (p1.second - p0.second);
+    }
+
+    // cubic Hermite between the two points
+    const double t2 = t * t;
+    const double t3 = t2 * t;
+    return (2.0 * t3 - 3.0 * t2 + 1.0) * p0.second + (t3 - 2.0 * t2 + t) * h * m_tangents[i] +
+           (-2.0 * t3 + 3.0 * t2) * p1.second + (t3 - t2) * h * m_tangents[i + 1];
+
+}
+
+
+
+} // namespace WP
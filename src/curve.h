@@ -0,0 +1,80 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+
+#define WP_CURVE_SEGMENTS 1024 // linear segments over the source range
+
+
+
+namespace WP {
+
+
+class Axis;
+
+
+// response curve of an axis to axis mapping, evaluated in doubles once at load time
+// and sampled into WP_CURVE_SEGMENTS + 1 target values, input and output are 0..1
+class Curve
+{
+
+
+public:
+    typedef std::pair<double, double> Point;
+
+    Curve();
+    ~Curve();
+
+    void set_deadzone(double deadzone);
+    void set_saturation(double saturation);
+    void set_gamma(double gamma);
+    void set_center(bool center);
+    void set_points(const std::vector<WP::Curve::Point> &points, bool spline);
+
+    double evaluate(double x) const;
+    void sample(bool src_invert, const WP::Axis *target, int32_t *knots) const;
+
+
+private:
+    double m_deadzone;
+    double m_saturation;
+    double m_gamma;
+    bool m_center;
+    std::vector<WP::Curve::Point> m_points;
+    std::vector<double> m_tangents; // monotone cubic spline, empty for straight lines
+
+    double shape(double x) const;
+    double interpolate(double x) const;
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // CURVE_H
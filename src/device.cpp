@@ -22,6 +22,8 @@
 #include "button.h"
 #include "utils.h"
 
+#include <string.h>
+
 
 #define VENDOR_IDX   0
 #define PRODUCT_IDXX 1
@@ -29,6 +31,8 @@
 
 #define INDEX(a, b) (a >= b ? a * a + a + b : a + b * b)
 
+#define BUTTON_WORDS(n) (((n) + 63) / 64)
+
 
 
 namespace WP {
@@ -48,15 +52,28 @@ Device::Device(const std::string &name, uint16_t vendor, uint16_t product, uint1
     m_buttons.swap(buttons);
     m_listener = nullptr;
 
+    // code -> index tables, dispatch must not depend on the number of buttons
+    memset(m_axis_index, 0xff, sizeof(m_axis_index));
+    memset(m_button_index, 0xff, sizeof(m_button_index));
+
+    for (size_t i = 0, s = m_axes.size(); i < s; ++i) {
+        m_axis_index[m_axes[i]->get_code()] = i;
+    }
+    for (size_t i = 0, s = m_buttons.size(); i < s; ++i) {
+        m_button_index[m_buttons[i]->get_code()] = i;
+    }
+
+    m_axis_values.assign(m_axes.size(), 0);
+    m_button_bits.assign(BUTTON_WORDS(m_buttons.size()), 0);
+    m_axis_ranges.assign(m_axes.size(), Range { 0, 0 });
+    m_button_ranges.assign(m_buttons.size(), Range { 0, 0 });
+
 }
 
 
 Device::~Device()
 {
 
-    DELETE_ALL(m_axes);
-    DELETE_ALL(m_buttons);
-
 }
 
 
@@ -118,13 +135,18 @@ WP::Axis *
 Device::get_axis_by_code(uint16_t code) const
 {
 
-    for (size_t i = 0, s = m_axes.size(); i < s; ++i) {
-        WP::Axis *axis = m_axes[i];
+    if (code >= ABS_CNT || m_axis_index[code] == WP_NO_INDEX) return nullptr;
+    return m_axes[m_axis_index[code]];
 
-        if (axis->get_code() == code) return axis;
-    }
+}
+
+
+uint16_t
+Device::get_axis_index(uint16_t code) const
+{
 
-    return nullptr;
+    if (code >= ABS_CNT) return WP_NO_INDEX;
+    return m_axis_index[code];
 
 }
 
@@ -133,7 +155,10 @@ void
 Device::add_axis(WP::Axis *axis)
 {
 
+    m_axis_index[axis->get_code()] = m_axes.size();
     m_axes.push_back(axis);
+    m_axis_values.push_back(0);
+    m_axis_ranges.push_back(Range { axis->get_map_begin(), axis->get_map_end() });
 
 }
 
@@ -160,13 +185,18 @@ WP::Button *
 Device::get_button_by_code(uint16_t code) const
 {
 
-    for (size_t i = 0, s = m_buttons.size(); i < s; ++i) {
-        WP::Button *button = m_buttons[i];
+    if (code >= KEY_CNT || m_button_index[code] == WP_NO_INDEX) return nullptr;
+    return m_buttons[m_button_index[code]];
 
-        if (button->get_code() == code) return button;
-    }
+}
 
-    return nullptr;
+
+uint16_t
+Device::get_button_index(uint16_t code) const
+{
+
+    if (code >= KEY_CNT) return WP_NO_INDEX;
+    return m_button_index[code];
 
 }
 
@@ -175,7 +205,84 @@ void
 Device::add_button(WP::Button *button)
 {
 
+    m_button_index[button->get_code()] = m_buttons.size();
     m_buttons.push_back(button);
+    m_button_bits.resize(BUTTON_WORDS(m_buttons.size()), 0);
+    m_button_ranges.push_back(Range { button->get_map_begin(), button->get_map_end() });
+
+}
+
+
+int32_t
+Device::get_axis_value(uint16_t slot) const
+{
+
+    return m_axis_values[slot];
+
+}
+
+
+void
+Device::set_axis_value(uint16_t slot, int32_t value)
+{
+
+    m_axis_values[slot] = value;
+
+}
+
+
+bool
+Device::get_button_down(uint16_t slot) const
+{
+
+    return (m_button_bits[slot / 64] >> (slot % 64)) & 1;
+
+}
+
+
+void
+Device::set_button_down(uint16_t slot, bool down)
+{
+
+    const uint64_t bit = 1ull << (slot % 64);
+    if (down) {
+        m_button_bits[slot / 64] |= bit;
+    } else {
+        m_button_bits[slot / 64] &= ~bit;
+    }
+
+}
+
+
+const WP::Device::Range &
+Device::get_axis_range(uint16_t slot) const
+{
+
+    return m_axis_ranges[slot];
+
+}
+
+
+const WP::Device::Range &
+Device::get_button_range(uint16_t slot) const
+{
+
+    return m_button_ranges[slot];
+
+}
+
+
+void
+Device::load_map_ranges()
+{
+
+    // copy the op ranges of the compiled map next to the state
+    for (size_t i = 0, s = m_axes.size(); i < s; ++i) {
+        m_axis_ranges[i] = Range { m_axes[i]->get_map_begin(), m_axes[i]->get_map_end() };
+    }
+    for (size_t i = 0, s = m_buttons.size(); i < s; ++i) {
+        m_button_ranges[i] = Range { m_buttons[i]->get_map_begin(), m_buttons[i]->get_map_end() };
+    }
 
 }
 
@@ -190,19 +297,28 @@ Device::set_listener(WP::Device::Listener *listener)
 
 
 void
-Device::onAxisChanged(WP::Axis *axis)
+Device::onAxisChanged(uint16_t slot, uint64_t time)
+{
+
+    m_listener->onDeviceAxisChanged(this, slot, time);
+
+}
+
+
+void
+Device::onButtonChanged(uint16_t slot, uint64_t time)
 {
 
-    m_listener->onDeviceAxisChanged(this, axis);
+    m_listener->onDeviceButtonChanged(this, slot, time);
 
 }
 
 
 void
-Device::onButtonChanged(WP::Button *button)
+Device::onFrame()
 {
 
-    m_listener->onDeviceButtonChanged(this, button);
+    m_listener->onDeviceFrame(this);
 
 }
 
@@ -22,8 +22,11 @@
 #include <string>
 #include <stdint.h>
 #include <vector>
+#include <linux/input.h>
 
 
+#define WP_NO_INDEX UINT16_MAX
+
 
 namespace WP {
 
@@ -38,8 +41,16 @@ class Device
 public:
     class Listener {
     public:
-        virtual void onDeviceAxisChanged(WP::Device *device, WP::Axis *axis) = 0;
-        virtual void onDeviceButtonChanged(WP::Device *device, WP::Button *button) = 0;
+        virtual void onDeviceAxisChanged(WP::Device *device, uint16_t slot, uint64_t time) = 0;
+        virtual void onDeviceButtonChanged(WP::Device *device, uint16_t slot, uint64_t time) = 0;
+        virtual void onDeviceFrame(WP::Device *device) = 0;
+    };
+
+
+    // [begin,end) of the compiled map ops of one axis or button
+    struct Range {
+        uint32_t begin;
+        uint32_t end;
     };
 
 
@@ -55,13 +66,24 @@ public:
     size_t get_axis_count() const;
     WP::Axis *get_axis_at(size_t i) const;
     WP::Axis *get_axis_by_code(uint16_t code) const;
+    uint16_t get_axis_index(uint16_t code) const;
     void add_axis(WP::Axis *axis);
 
     size_t get_button_count() const;
     WP::Button *get_button_at(size_t i) const;
     WP::Button *get_button_by_code(uint16_t code) const;
+    uint16_t get_button_index(uint16_t code) const;
     void add_button(WP::Button *button);
 
+    int32_t get_axis_value(uint16_t slot) const;
+    void set_axis_value(uint16_t slot, int32_t value);
+    bool get_button_down(uint16_t slot) const;
+    void set_button_down(uint16_t slot, bool down);
+
+    const WP::Device::Range &get_axis_range(uint16_t slot) const;
+    const WP::Device::Range &get_button_range(uint16_t slot) const;
+    void load_map_ranges();
+
 
     virtual bool open() = 0;
     virtual void close() = 0;
@@ -70,8 +92,9 @@ public:
 
 
 protected:
-    void onAxisChanged(WP::Axis *axis);
-    void onButtonChanged(WP::Button *button);
+    void onAxisChanged(uint16_t slot, uint64_t time);
+    void onButtonChanged(uint16_t slot, uint64_t time);
+    void onFrame();
 
 
 private:
@@ -81,6 +104,14 @@ private:
     std::vector<WP::Axis*> m_axes;
     WP::Device::Listener *m_listener;
 
+    // hot state by slot, the axis and button objects above only hold the config
+    std::vector<int32_t> m_axis_values;
+    std::vector<uint64_t> m_button_bits;
+    std::vector<WP::Device::Range> m_axis_ranges;
+    std::vector<WP::Device::Range> m_button_ranges;
+    uint16_t m_button_index[KEY_CNT];
+    uint16_t m_axis_index[ABS_CNT];
+
     bool src_event(WP::Event *event) const;
     bool dest_event(const WP::Event *event);
 
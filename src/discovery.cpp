@@ -0,0 +1,291 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "discovery.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#define WP_SYSFS_INPUT "/sys/class/input/"
+
+
+// every event node seen so far, reading sysfs is only needed for new ones.
+// A node number can be reused by another device, its sysfs entry is new then
+struct wp_cached_device {
+    WP::Discovery::DeviceInfo info;
+    ino_t ino;
+    struct timespec ctime;
+};
+
+static std::vector<wp_cached_device> g_wp_devices;
+
+// nodes opened by a source device, identical devices must not share one
+static std::vector<std::string> g_wp_claimed;
+
+
+
+static bool
+read_sysfs(const std::string &path, char *buffer, size_t size)
+{
+
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    ssize_t r;
+    do {
+        r = read(fd, buffer, size - 1);
+    } while (r < 0 && errno == EINTR);
+    close(fd);
+
+    if (r < 0) return false;
+
+    while (r > 0 && (buffer[r - 1] == '\n' || buffer[r - 1] == '\0')) --r;
+    buffer[r] = '\0';
+    return true;
+
+}
+
+
+static uint16_t
+read_sysfs_id(const std::string &dir, const char *id)
+{
+
+    char buffer[16];
+    if (!read_sysfs(dir + "id/" + id, buffer, sizeof(buffer))) return 0;
+    return strtoul(buffer, nullptr, 16);
+
+}
+
+
+static std::string
+read_sysfs_string(const std::string &dir, const char *file)
+{
+
+    char buffer[256];
+    if (!read_sysfs(dir + file, buffer, sizeof(buffer))) return std::string();
+    return std::string(buffer);
+
+}
+
+
+static bool
+read_device_info(const char *handler, WP::Discovery::DeviceInfo *info)
+{
+
+    const std::string dir = std::string(WP_SYSFS_INPUT) + handler + "/device/";
+
+    char buffer[16];
+    if (!read_sysfs(dir + "id/vendor", buffer, sizeof(buffer))) return false;
+
+    info->handler = handler;
+    info->vendor = strtoul(buffer, nullptr, 16);
+    info->product = read_sysfs_id(dir, "product");
+    info->version = read_sysfs_id(dir, "version");
+    info->bustype = read_sysfs_id(dir, "bustype");
+    info->name = read_sysfs_string(dir, "name");
+    info->phys = read_sysfs_string(dir, "phys");
+    info->uniq = read_sysfs_string(dir, "uniq");
+    return true;
+
+}
+
+
+static bool
+stat_node(const char *handler, wp_cached_device *device)
+{
+
+    struct stat st;
+    if (stat((std::string(WP_SYSFS_INPUT) + handler).c_str(), &st) < 0) return false;
+
+    device->ino = st.st_ino;
+    device->ctime = st.st_ctim;
+    return true;
+
+}
+
+
+static bool
+is_event_handler(const char *name)
+{
+
+    if (strncmp(name, "event", 5) != 0 || name[5] == '\0') return false;
+
+    for (const char *c = name + 5; *c != '\0'; ++c) {
+        if (*c < '0' || *c > '9') return false;
+    }
+    return true;
+
+}
+
+
+static bool
+device_matches(const WP::Discovery::DeviceInfo &info, uint16_t vendor, uint16_t product, uint16_t version,
+               const std::string &phys, const std::string &uniq)
+{
+
+    // version, phys and uniq are optional, zero or empty matches everything
+    return info.vendor == vendor && info.product == product &&
+            (version == 0 || info.version == version) &&
+            (phys.empty() || info.phys.compare(phys) == 0) &&
+            (uniq.empty() || info.uniq.compare(uniq) == 0);
+
+}
+
+
+
+namespace WP {
+
+
+
+bool
+Discovery::scan(std::vector<WP::Discovery::DeviceInfo> *devices)
+{
+
+    DIR *dir = opendir(WP_SYSFS_INPUT);
+    if (dir == nullptr) {
+        perror(WP_SYSFS_INPUT);
+        return false;
+    }
+
+    std::vector<wp_cached_device> current;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (!is_event_handler(entry->d_name)) continue;
+
+        wp_cached_device device;
+        if (!stat_node(entry->d_name, &device)) continue;
+
+        bool cached = false;
+        for (size_t i = 0, s = g_wp_devices.size(); i < s; ++i) {
+            const wp_cached_device &old = g_wp_devices[i];
+            if (old.info.handler.compare(entry->d_name) != 0) continue;
+
+            cached = old.ino == device.ino && old.ctime.tv_sec == device.ctime.tv_sec &&
+                    old.ctime.tv_nsec == device.ctime.tv_nsec;
+            if (cached) current.push_back(old);
+            break;
+        }
+        if (cached) continue;
+
+        if (read_device_info(entry->d_name, &device.info)) {
+            current.push_back(device);
+        }
+    }
+    closedir(dir);
+
+    // nodes which are gone drop out of the cache
+    g_wp_devices.swap(current);
+
+    if (devices != nullptr) {
+        devices->clear();
+        for (size_t i = 0, s = g_wp_devices.size(); i < s; ++i) {
+            devices->push_back(g_wp_devices[i].info);
+        }
+    }
+
+    return true;
+
+}
+
+
+bool
+Discovery::find(uint16_t vendor, uint16_t product, uint16_t version,
+                const std::string &phys, const std::string &uniq,
+                WP::Discovery::DeviceInfo *info)
+{
+
+    if (!scan(nullptr)) return false;
+
+    for (size_t i = 0, s = g_wp_devices.size(); i < s; ++i) {
+        const WP::Discovery::DeviceInfo &device = g_wp_devices[i].info;
+        if (!device_matches(device, vendor, product, version, phys, uniq)) continue;
+        if (std::find(g_wp_claimed.begin(), g_wp_claimed.end(), device.handler) != g_wp_claimed.end()) continue;
+
+        *info = device;
+        return true;
+    }
+
+    return false;
+
+}
+
+
+void
+Discovery::claim(const std::string &handler)
+{
+
+    g_wp_claimed.push_back(handler);
+
+}
+
+
+void
+Discovery::release(const std::string &handler)
+{
+
+    const auto it = std::find(g_wp_claimed.begin(), g_wp_claimed.end(), handler);
+    if (it != g_wp_claimed.end()) {
+        g_wp_claimed.erase(it);
+    }
+
+}
+
+
+bool
+Discovery::find_handler(const std::string &handler, WP::Discovery::DeviceInfo *info)
+{
+
+    if (!scan(nullptr)) return false;
+
+    for (size_t i = 0, s = g_wp_devices.size(); i < s; ++i) {
+        if (g_wp_devices[i].info.handler.compare(handler) == 0) {
+            *info = g_wp_devices[i].info;
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+
+void
+Discovery::invalidate(const std::string &handler)
+{
+
+    for (auto it = g_wp_devices.begin(); it != g_wp_devices.end(); ++it) {
+        if ((*it).info.handler.compare(handler) == 0) {
+            g_wp_devices.erase(it);
+            return;
+        }
+    }
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,67 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+
+namespace WP {
+
+
+
+class Discovery
+{
+
+
+public:
+    struct DeviceInfo {
+        std::string handler;
+        std::string name;
+        std::string phys;
+        std::string uniq;
+        uint16_t bustype;
+        uint16_t vendor;
+        uint16_t product;
+        uint16_t version;
+    };
+
+
+    static bool scan(std::vector<WP::Discovery::DeviceInfo> *devices);
+    static bool find(uint16_t vendor, uint16_t product, uint16_t version,
+                     const std::string &phys, const std::string &uniq,
+                     WP::Discovery::DeviceInfo *info);
+    static bool find_handler(const std::string &handler, WP::Discovery::DeviceInfo *info);
+    static void claim(const std::string &handler);
+    static void release(const std::string &handler);
+    static void invalidate(const std::string &handler);
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // DISCOVERY_H
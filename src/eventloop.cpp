@@ -0,0 +1,329 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "eventloop.h"
+#include "sourcedevice.h"
+#include "targetdevice.h"
+#include "application.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+
+#define MS_TO_NS(ms) ((uint64_t) (ms) * 1000000ULL)
+
+
+
+namespace WP {
+
+
+
+EventLoop::EventLoop(WP::TargetDevice *target)
+{
+
+    m_epoll = -1;
+    m_target = target;
+    m_recover_time = 0;
+    m_spin_time = 0;
+    m_spin_end = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+}
+
+
+EventLoop::~EventLoop()
+{
+
+    DELETE_ALL(m_sources);
+
+    if (m_epoll != -1) {
+        ::close(m_epoll);
+    }
+
+}
+
+
+void
+EventLoop::add_source(WP::SourceDevice *src)
+{
+
+    m_sources.push_back(src);
+
+}
+
+
+size_t
+EventLoop::get_source_count() const
+{
+
+    return m_sources.size();
+
+}
+
+
+WP::SourceDevice *
+EventLoop::get_source_at(size_t i) const
+{
+
+    return m_sources[i];
+
+}
+
+
+void
+EventLoop::set_spin_time(uint64_t ns)
+{
+
+    m_spin_time = ns;
+
+}
+
+
+bool
+EventLoop::open()
+{
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll < 0) {
+        perror("epoll_create1");
+        return false;
+    }
+
+
+    if (m_hotplug.open()) {
+        struct epoll_event event = { };
+        event.events = EPOLLIN;
+        event.data.ptr = &m_hotplug;
+
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_hotplug.get_fd(), &event) < 0) {
+            perror("epoll_ctl");
+            m_hotplug.close();
+        }
+    }
+
+    if (m_hotplug.get_fd() < 0) {
+        printf("hotplug detection not available, lost devices are polled every %d ms\n", WP_RECOVER_INTERVAL_MS);
+    }
+
+
+    // chord windows, macro steps and settling input filters run from the same loop
+    if (!m_timers.open()) return false;
+
+    struct epoll_event timer_event = { };
+    timer_event.events = EPOLLIN;
+    timer_event.data.ptr = &m_timers;
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timers.get_fd(), &timer_event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+
+    m_target->set_timers(&m_timers);
+
+
+    for (size_t i = 0, s = m_sources.size(); i < s; ++i) {
+        WP::SourceDevice *src = m_sources[i];
+        src->set_timers(&m_timers);
+        if (!src->open() || !watch(src)) return false;
+    }
+
+    return true;
+
+}
+
+
+bool
+EventLoop::run(volatile bool *stop)
+{
+
+    for (size_t i = 0, s = m_sources.size(); i < s; ++i) {
+        m_target->sync(m_sources[i]);
+    }
+
+
+    struct epoll_event events[WP_EVENT_LOOP_MAX_EVENTS];
+    while (!*stop) {
+        const int n = wait(events);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return false;
+        }
+
+        bool hotplug = false;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.ptr == &m_hotplug) {
+                hotplug = true;
+                continue;
+            }
+
+            if (events[i].data.ptr == &m_timers) {
+                m_timers.read_events();
+                continue;
+            }
+
+            WP::SourceDevice *src = (WP::SourceDevice*) events[i].data.ptr;
+            if (!src->read_events()) {
+                lost(src);
+            }
+        }
+
+        // devices lost in this round are handled before looking at new device nodes
+        if (hotplug && m_hotplug.read_events() && m_lost.size() > 0) {
+            recover();
+        } else if (m_hotplug.get_fd() < 0 && m_lost.size() > 0 && WP::Utils::get_time() >= m_recover_time) {
+            recover();
+        }
+    }
+
+    return true;
+
+}
+
+
+bool
+EventLoop::watch(WP::SourceDevice *src)
+{
+
+    struct epoll_event event = { };
+    event.events = EPOLLIN;
+    event.data.ptr = src;
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, src->get_fd(), &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+
+    return true;
+
+}
+
+
+void
+EventLoop::lost(WP::SourceDevice *src)
+{
+
+    printf("input device \"%s\" lost, waiting for it to come back...\nPress Ctrl+C to stop.\n", src->get_name().c_str());
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, src->get_fd(), nullptr);
+    src->close();
+
+    WP::EventLoop::LostDevice dev;
+    dev.src = src;
+    dev.time = WP::Utils::get_time();
+
+    if (m_lost.size() < 1) {
+        m_recover_time = dev.time + MS_TO_NS(WP_RECOVER_INTERVAL_MS);
+    }
+    m_lost.push_back(dev);
+
+}
+
+
+void
+EventLoop::recover()
+{
+
+    for (auto it = m_lost.begin(); it != m_lost.end();) {
+        WP::SourceDevice *src = (*it).src;
+
+        if (src->open() && watch(src)) {
+            m_target->sync(src);
+
+            const uint64_t t = WP::Utils::get_time() - (*it).time;
+            m_stats.reconnects++;
+            m_stats.reconnect_time_total += t;
+            if (t > m_stats.reconnect_time_max) m_stats.reconnect_time_max = t;
+
+            if (WP::Application::get_verbose()) {
+                printf("[Input] device \"%s\" reconnected after %.3f ms\n", src->get_name().c_str(), t / 1000000.0);
+            }
+
+            it = m_lost.erase(it);
+        } else {
+            src->close();
+            ++it;
+        }
+    }
+
+    m_recover_time = WP::Utils::get_time() + MS_TO_NS(WP_RECOVER_INTERVAL_MS);
+
+}
+
+
+const WP::EventLoop::Stats &
+EventLoop::get_stats() const
+{
+
+    return m_stats;
+
+}
+
+
+int
+EventLoop::wait(struct epoll_event *events)
+{
+
+    if (m_spin_time < 1) {
+        return epoll_wait(m_epoll, events, WP_EVENT_LOOP_MAX_EVENTS, get_timeout());
+    }
+
+
+    // keep polling without sleeping for a while after the last event
+    const uint64_t start = WP::Utils::get_time();
+    const bool spin = start < m_spin_end;
+    const int n = epoll_wait(m_epoll, events, WP_EVENT_LOOP_MAX_EVENTS, spin ? 0 : get_timeout());
+    const uint64_t end = WP::Utils::get_time();
+
+    if (spin) {
+        m_stats.spin_time += end - start;
+        if (n > 0) m_stats.spin_hits++;
+    } else {
+        m_stats.sleep_time += end - start;
+        m_stats.sleeps++;
+    }
+
+    if (n > 0) {
+        m_spin_end = end + m_spin_time;
+    }
+
+    return n;
+
+}
+
+
+int
+EventLoop::get_timeout() const
+{
+
+    // with hotplug detection we sleep until a device node shows up
+    if (m_lost.size() < 1 || m_hotplug.get_fd() >= 0) return -1;
+
+    const uint64_t now = WP::Utils::get_time();
+    if (now >= m_recover_time) return 0;
+    return (m_recover_time - now) / 1000000 + 1;
+
+}
+
+
+
+} // namespace WP
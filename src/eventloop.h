@@ -0,0 +1,106 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "hotplug.h"
+#include "timers.h"
+
+
+struct epoll_event;
+
+
+#define WP_EVENT_LOOP_MAX_EVENTS 16
+#define WP_RECOVER_INTERVAL_MS   2000
+
+
+namespace WP {
+
+
+
+class SourceDevice;
+class TargetDevice;
+class EventLoop
+{
+
+
+public:
+    struct Stats {
+        uint64_t reconnects;
+        uint64_t reconnect_time_total;
+        uint64_t reconnect_time_max;
+        uint64_t spin_time;
+        uint64_t spin_hits;
+        uint64_t sleep_time;
+        uint64_t sleeps;
+    };
+
+
+    EventLoop(WP::TargetDevice *target);
+    ~EventLoop();
+
+    void add_source(WP::SourceDevice *src);
+    size_t get_source_count() const;
+    WP::SourceDevice *get_source_at(size_t i) const;
+
+    void set_spin_time(uint64_t ns);
+
+    bool open();
+    bool run(volatile bool *stop);
+
+    const WP::EventLoop::Stats &get_stats() const;
+
+
+private:
+    struct LostDevice {
+        WP::SourceDevice *src;
+        uint64_t time;
+    };
+
+    int m_epoll;
+    WP::TargetDevice *m_target;
+    WP::Hotplug m_hotplug;
+    WP::Timers m_timers;
+    std::vector<WP::SourceDevice*> m_sources;
+    std::vector<WP::EventLoop::LostDevice> m_lost;
+    uint64_t m_recover_time;
+    uint64_t m_spin_time;
+    uint64_t m_spin_end;
+    WP::EventLoop::Stats m_stats;
+
+    bool watch(WP::SourceDevice *src);
+    void lost(WP::SourceDevice *src);
+    void recover();
+    int wait(struct epoll_event *events);
+    int get_timeout() const;
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // EVENTLOOP_H
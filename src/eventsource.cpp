@@ -26,6 +26,9 @@ EventSource::EventSource(Type type)
 
     m_type = type;
     m_code = 0;
+    m_device = 0;
+    m_map_range[0] = 0;
+    m_map_range[1] = 0;
 
 }
 
@@ -82,5 +85,51 @@ EventSource::set_name(const std::string &name)
 }
 
 
+uint16_t
+EventSource::get_device() const
+{
+
+    return m_device;
+
+}
+
+
+void
+EventSource::set_device(uint16_t device)
+{
+
+    m_device = device;
+
+}
+
+
+uint32_t
+EventSource::get_map_begin() const
+{
+
+    return m_map_range[0];
+
+}
+
+
+uint32_t
+EventSource::get_map_end() const
+{
+
+    return m_map_range[1];
+
+}
+
+
+void
+EventSource::set_map_range(uint32_t begin, uint32_t end)
+{
+
+    m_map_range[0] = begin;
+    m_map_range[1] = end;
+
+}
+
+
 
 } // namespace WP
@@ -51,11 +51,21 @@ public:
     std::string get_name() const;
     void set_name(const std::string &name);
 
+    // index of the input device in the config, 0 for the output device
+    uint16_t get_device() const;
+    void set_device(uint16_t device);
+
+    uint32_t get_map_begin() const;
+    uint32_t get_map_end() const;
+    void set_map_range(uint32_t begin, uint32_t end);
+
 
 private:
     Type m_type;
     std::string m_name;
     uint16_t m_code;
+    uint16_t m_device;
+    uint32_t m_map_range[2];
 
 
 };
@@ -0,0 +1,252 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#include "filter.h"
+#include "utils.h"
+
+#include <cstring>
+
+
+#define WP_FILTER_MAX_CUTOFF 1000000000ULL // mHz
+#define WP_FILTER_TAU_SCALE  159154943ULL  // 1e6 us / (2 pi) in mHz
+
+
+
+static int64_t
+blend(int64_t value, int64_t target, uint32_t alpha)
+{
+
+    // value + (target - value) * alpha, alpha in 16.16
+    return value + (int64_t) ((((__int128) (target - value)) * alpha + 0x8000) >> 16);
+
+}
+
+
+static uint32_t
+get_alpha(uint64_t cutoff, uint64_t dt)
+{
+
+    // weight of a first order low pass with this cutoff (mHz) after dt (us)
+    const uint64_t tau = WP_FILTER_TAU_SCALE / (cutoff > 0 ? cutoff : 1);
+    const uint64_t alpha = (dt << 16) / (dt + tau);
+    return alpha > 0 ? alpha : 1;
+
+}
+
+
+static int32_t
+median3(int32_t a, int32_t b, int32_t c)
+{
+
+    if (a > b) {
+        const int32_t t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : (c > b ? b : c);
+
+}
+
+
+
+namespace WP {
+
+
+
+Filter::Filter()
+{
+
+    memset(m_stages, 0, sizeof(m_stages));
+    m_count = 0;
+
+}
+
+
+Filter::~Filter()
+{
+
+}
+
+
+bool
+Filter::add_ema(double alpha)
+{
+
+    if (alpha <= 0.0 || alpha > 1.0) return false;
+
+    WP::Filter::Stage *stage = add_stage(EMA);
+    if (stage == nullptr) return false;
+
+    stage->alpha = (uint32_t) (alpha * 65536.0 + 0.5);
+    return true;
+
+}
+
+
+bool
+Filter::add_one_euro(double min_cutoff, double beta, double d_cutoff, uint32_t src_range)
+{
+
+    if (min_cutoff <= 0.0 || beta < 0.0 || d_cutoff <= 0.0 || src_range == 0) return false;
+
+    WP::Filter::Stage *stage = add_stage(ONE_EURO);
+    if (stage == nullptr) return false;
+
+    // beta is configured per full range/s, the filter works in source units/s
+    stage->min_cutoff = (uint32_t) (min_cutoff * 1000.0 + 0.5);
+    stage->d_cutoff = (uint32_t) (d_cutoff * 1000.0 + 0.5);
+    stage->beta = (uint64_t) (beta * 1000.0 * 4294967296.0 / src_range + 0.5);
+    return true;
+
+}
+
+
+bool
+Filter::add_median3()
+{
+
+    return add_stage(MEDIAN3) != nullptr;
+
+}
+
+
+size_t
+Filter::get_stage_count() const
+{
+
+    return m_count;
+
+}
+
+
+void
+Filter::reset(WP::Filter::State *state, int32_t value, uint64_t time) const
+{
+
+    for (size_t i = 0; i < WP_FILTER_STAGES; ++i) {
+        WP::Filter::StageState &stage = state->stages[i];
+        stage.value = (int64_t) value << 16;
+        stage.dx = 0;
+        stage.history[0] = value;
+        stage.history[1] = value;
+    }
+
+    state->time = time;
+    state->raw = value;
+    state->output = value;
+    state->primed = true;
+
+}
+
+
+int32_t
+Filter::apply(WP::Filter::State *state, int32_t value, uint64_t time) const
+{
+
+    if (time == 0) time = WP::Utils::get_time();
+
+    if (!state->primed) {
+        reset(state, value, time);
+        return value;
+    }
+
+    uint64_t dt = time > state->time ? (time - state->time) / 1000 : 0;
+    if (dt < 1) dt = 1;
+    else if (dt > WP_FILTER_MAX_DT) dt = WP_FILTER_MAX_DT;
+    state->time = time;
+    state->raw = value;
+
+    for (size_t i = 0; i < m_count; ++i) {
+        const WP::Filter::Stage &stage = m_stages[i];
+        WP::Filter::StageState &s = state->stages[i];
+
+        switch (stage.type) {
+        case EMA:
+            s.value = blend(s.value, (int64_t) value << 16, stage.alpha);
+            value = (s.value + 0x8000) >> 16;
+            break;
+
+        case ONE_EURO: {
+            const int64_t x = (int64_t) value << 16;
+            const int64_t rate = (int64_t) (((__int128) (x - s.value) * 1000000) / (int64_t) dt);
+            s.dx = blend(s.dx, rate, get_alpha(stage.d_cutoff, dt));
+
+            const uint64_t speed = (uint64_t) (s.dx < 0 ? -s.dx : s.dx) >> 16;
+            uint64_t cutoff = stage.min_cutoff + (uint64_t) (((unsigned __int128) speed * stage.beta) >> 32);
+            if (cutoff > WP_FILTER_MAX_CUTOFF) cutoff = WP_FILTER_MAX_CUTOFF;
+
+            s.value = blend(s.value, x, get_alpha(cutoff, dt));
+            value = (s.value + 0x8000) >> 16;
+            break;
+        }
+
+        case MEDIAN3: {
+            const int32_t median = median3(s.history[0], s.history[1], value);
+            s.history[0] = s.history[1];
+            s.history[1] = value;
+            value = median;
+            break;
+        }
+
+        default: break;
+        }
+    }
+
+    state->output = value;
+    return value;
+
+}
+
+
+uint64_t
+Filter::get_settle_time(const WP::Filter::State *state) const
+{
+
+    if (!state->primed || state->output == state->raw) return 0;
+    return state->time + WP_FILTER_SETTLE;
+
+}
+
+
+int32_t
+Filter::settle(WP::Filter::State *state) const
+{
+
+    // the median ends the step, the averages stop trailing it
+    reset(state, state->raw, state->time);
+    return state->raw;
+
+}
+
+
+WP::Filter::Stage *
+Filter::add_stage(uint8_t type)
+{
+
+    if (m_count >= WP_FILTER_STAGES) return nullptr;
+
+    WP::Filter::Stage *stage = &m_stages[m_count++];
+    stage->type = type;
+    return stage;
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,106 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define WP_FILTER_STAGES 3
+#define WP_FILTER_MAX_DT 1000000 // us, longer pauses count as this
+#define WP_FILTER_SETTLE 20000000 // ns without events after which the output jumps to the last raw value
+
+
+
+namespace WP {
+
+
+
+// smoothing of one source axis, applied to every raw value before it is mapped,
+// all state is integer or 16.16 fixed point so each stage is a few multiplies
+class Filter
+{
+
+
+public:
+    enum Type : uint8_t {
+        EMA,      // exponential moving average with a fixed weight
+        ONE_EURO, // EMA with a cutoff that rises with the speed of the axis
+        MEDIAN3   // median of the last three values, drops single spikes
+    };
+
+    struct Stage {
+        uint8_t type;
+        uint32_t alpha;      // ema: weight of a new value, 16.16
+        uint32_t min_cutoff; // one euro: mHz
+        uint32_t d_cutoff;   // one euro: cutoff of the speed estimate, mHz
+        uint64_t beta;       // one euro: mHz per source unit/s, 32.32
+    };
+
+    struct StageState {
+        int64_t value; // 16.16
+        int64_t dx;    // 16.16 source units/s
+        int32_t history[2];
+    };
+
+    struct State {
+        WP::Filter::StageState stages[WP_FILTER_STAGES];
+        uint64_t time;
+        int32_t raw;    // last input
+        int32_t output; // last result
+        bool primed;
+    };
+
+
+    Filter();
+    ~Filter();
+
+    bool add_ema(double alpha);
+    bool add_one_euro(double min_cutoff, double beta, double d_cutoff, uint32_t src_range);
+    bool add_median3();
+
+    size_t get_stage_count() const;
+
+    void reset(WP::Filter::State *state, int32_t value, uint64_t time) const;
+    int32_t apply(WP::Filter::State *state, int32_t value, uint64_t time) const;
+
+    // a held axis sends no events, without them the output would stay wherever the smoothing was:
+    // time the output is due to settle on the last raw value, 0 if it is there already
+    uint64_t get_settle_time(const WP::Filter::State *state) const;
+    int32_t settle(WP::Filter::State *state) const;
+
+
+private:
+    WP::Filter::Stage m_stages[WP_FILTER_STAGES];
+    size_t m_count;
+
+    WP::Filter::Stage *add_stage(uint8_t type);
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // FILTER_H
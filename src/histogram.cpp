@@ -0,0 +1,148 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "histogram.h"
+
+#include <string.h>
+
+
+
+namespace WP {
+
+
+
+Histogram::Histogram()
+{
+
+    clear();
+
+}
+
+
+void
+Histogram::add(uint64_t value)
+{
+
+    m_buckets[get_bucket(value)]++;
+    m_count++;
+    m_sum += value;
+    if (value < m_min) m_min = value;
+    if (value > m_max) m_max = value;
+
+}
+
+
+void
+Histogram::clear()
+{
+
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_sum = 0;
+    m_min = UINT64_MAX;
+    m_max = 0;
+
+}
+
+
+uint64_t
+Histogram::get_count() const
+{
+
+    return m_count;
+
+}
+
+
+uint64_t
+Histogram::get_min() const
+{
+
+    return m_count > 0 ? m_min : 0;
+
+}
+
+
+uint64_t
+Histogram::get_max() const
+{
+
+    return m_max;
+
+}
+
+
+uint64_t
+Histogram::get_mean() const
+{
+
+    return m_count > 0 ? m_sum / m_count : 0;
+
+}
+
+
+uint64_t
+Histogram::get_percentile(double p) const
+{
+
+    if (m_count < 1) return 0;
+
+    const uint64_t rank = p * m_count;
+    uint64_t n = 0;
+    for (size_t i = 0; i < WP_HISTOGRAM_BUCKETS; ++i) {
+        n += m_buckets[i];
+        if (n > rank) {
+            const uint64_t value = get_bucket_value(i);
+            return value > m_max ? m_max : (value < m_min ? m_min : value);
+        }
+    }
+
+    return m_max;
+
+}
+
+
+size_t
+Histogram::get_bucket(uint64_t value)
+{
+
+    if (value < WP_HISTOGRAM_SUB) return value;
+
+    const int exp = 63 - __builtin_clzll(value);
+    const int shift = exp - WP_HISTOGRAM_SUB_BITS;
+    return (shift + 1) * WP_HISTOGRAM_SUB + ((value >> shift) & (WP_HISTOGRAM_SUB - 1));
+
+}
+
+
+uint64_t
+Histogram::get_bucket_value(size_t bucket)
+{
+
+    // upper bound of the bucket
+    if (bucket < WP_HISTOGRAM_SUB) return bucket;
+
+    const int shift = bucket / WP_HISTOGRAM_SUB - 1;
+    const uint64_t sub = bucket % WP_HISTOGRAM_SUB;
+    return ((WP_HISTOGRAM_SUB + sub + 1) << shift) - 1;
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,74 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// values below 2^WP_HISTOGRAM_SUB_BITS are exact, above that every power
+// of two is split into 2^WP_HISTOGRAM_SUB_BITS buckets
+#define WP_HISTOGRAM_SUB_BITS 4
+#define WP_HISTOGRAM_SUB      (1 << WP_HISTOGRAM_SUB_BITS)
+#define WP_HISTOGRAM_BUCKETS  ((64 - WP_HISTOGRAM_SUB_BITS + 1) * WP_HISTOGRAM_SUB)
+
+
+
+namespace WP {
+
+
+
+class Histogram
+{
+
+
+public:
+    Histogram();
+
+    void add(uint64_t value);
+    void clear();
+
+    uint64_t get_count() const;
+    uint64_t get_min() const;
+    uint64_t get_max() const;
+    uint64_t get_mean() const;
+    uint64_t get_percentile(double p) const;
+
+
+private:
+    uint64_t m_buckets[WP_HISTOGRAM_BUCKETS];
+    uint64_t m_count;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+
+    static size_t get_bucket(uint64_t value);
+    static uint64_t get_bucket_value(size_t bucket);
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,135 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "hotplug.h"
+#include "application.h"
+#include "discovery.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+
+#define WP_HOTPLUG_DIR "/dev/input"
+
+
+
+namespace WP {
+
+
+
+Hotplug::Hotplug()
+{
+
+    m_fd = -1;
+
+}
+
+
+Hotplug::~Hotplug()
+{
+
+    close();
+
+}
+
+
+bool
+Hotplug::open()
+{
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        perror("inotify_init1");
+        return false;
+    }
+
+    // udev creates the node first and fixes up the permissions afterwards
+    if (inotify_add_watch(m_fd, WP_HOTPLUG_DIR, IN_CREATE | IN_ATTRIB) < 0) {
+        perror("inotify_add_watch " WP_HOTPLUG_DIR);
+        close();
+        return false;
+    }
+
+    return true;
+
+}
+
+
+void
+Hotplug::close()
+{
+
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+}
+
+
+int
+Hotplug::get_fd() const
+{
+
+    return m_fd;
+
+}
+
+
+bool
+Hotplug::read_events()
+{
+
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+
+    for (;;) {
+        const ssize_t r = read(m_fd, buffer, sizeof(buffer));
+        if (r <= 0) {
+            if (r < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("read inotify");
+            }
+            break;
+        }
+
+        for (ssize_t i = 0; i < r;) {
+            const struct inotify_event *event = (const struct inotify_event*) (buffer + i);
+            i += sizeof(struct inotify_event) + event->len;
+
+            if (event->len > 0 && strncmp(event->name, "event", 5) == 0) {
+                if (WP::Application::get_verbose()) {
+                    printf("[Hotplug] %s " WP_HOTPLUG_DIR "/%s\n", event->mask & IN_CREATE ? "created" : "changed", event->name);
+                }
+                if (event->mask & IN_CREATE) {
+                    WP::Discovery::invalidate(event->name);
+                }
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+
+}
+
+
+
+} // namespace WP
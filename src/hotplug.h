@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+
+
+namespace WP {
+
+
+
+class Hotplug
+{
+
+
+public:
+    Hotplug();
+    ~Hotplug();
+
+    bool open();
+    void close();
+
+    int get_fd() const;
+    bool read_events();
+
+
+private:
+    int m_fd;
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // HOTPLUG_H
@@ -0,0 +1,325 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#include "log.h"
+#include "device.h"
+#include "axis.h"
+#include "button.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <thread>
+
+
+#define WP_LOG_BUFFER_SIZE (16 * 1024) // formatted records written at once
+
+
+static int g_wp_log_wake_fd = -1; // the event loop wakes the sleeping log thread
+static int g_wp_log_done_fd = -1; // the log thread is drained and about to exit
+static uint64_t g_wp_log_records = 0; // only touched by the log thread until it is done
+
+// written with write(2), the event loop never waits for the stdout lock held by the thread
+static char g_wp_log_buffer[WP_LOG_BUFFER_SIZE];
+static size_t g_wp_log_length = 0;
+
+
+
+static void
+flush_buffer()
+{
+
+    size_t done = 0;
+    while (done < g_wp_log_length) {
+        const ssize_t r = write(STDOUT_FILENO, g_wp_log_buffer + done, g_wp_log_length - done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        done += r;
+    }
+    g_wp_log_length = 0;
+
+}
+
+
+static void
+append(const char *fmt, ...)
+{
+
+    // no record is longer than this, names are limited by the kernel
+    if (WP_LOG_BUFFER_SIZE - g_wp_log_length < 1024) flush_buffer();
+
+    va_list args;
+    va_start(args, fmt);
+    const int r = vsnprintf(g_wp_log_buffer + g_wp_log_length, WP_LOG_BUFFER_SIZE - g_wp_log_length, fmt, args);
+    va_end(args);
+
+    if (r > 0) {
+        g_wp_log_length += std::min((size_t) r, WP_LOG_BUFFER_SIZE - g_wp_log_length - 1);
+    }
+
+}
+
+
+static void
+signal_fd(int fd)
+{
+
+    const uint64_t one = 1;
+    ssize_t r;
+    do {
+        r = write(fd, &one, sizeof(one));
+    } while (r < 0 && errno == EINTR);
+
+}
+
+
+static void
+wait_fd(int fd)
+{
+
+    uint64_t count;
+    ssize_t r;
+    do {
+        r = read(fd, &count, sizeof(count));
+    } while (r < 0 && errno == EINTR);
+
+}
+
+
+static const char *
+get_axis_name(const WP::Device *device, uint16_t slot, int *code)
+{
+
+    const WP::Axis *axis = device->get_axis_at(slot);
+    *code = axis->get_code();
+    return axis->get_name().c_str();
+
+}
+
+
+static const char *
+get_button_name(const WP::Device *device, uint16_t slot, int *code)
+{
+
+    const WP::Button *button = device->get_button_at(slot);
+    *code = button->get_code();
+    return button->get_name().c_str();
+
+}
+
+
+
+namespace WP {
+
+
+
+WP::Log::Record Log::s_ring[WP_LOG_RING_SIZE];
+alignas(64) std::atomic<size_t> Log::s_head(0);
+alignas(64) std::atomic<size_t> Log::s_tail(0);
+alignas(64) std::atomic<uint64_t> Log::s_drops(0);
+std::atomic<bool> Log::s_running(false);
+std::atomic<bool> Log::s_idle(false);
+
+
+bool
+Log::start()
+{
+
+    if (s_running.load()) return true;
+
+    g_wp_log_wake_fd = eventfd(0, EFD_CLOEXEC);
+    g_wp_log_done_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_wp_log_wake_fd < 0 || g_wp_log_done_fd < 0) {
+        perror("eventfd");
+        goto failed;
+    }
+
+    s_running.store(true);
+    try {
+        // never joined, stop() waits for the done event instead of a futex
+        std::thread(&Log::run).detach();
+    } catch (const std::system_error &e) {
+        s_running.store(false);
+        printf("failed to start the log thread: %s\n", e.what());
+        goto failed;
+    }
+
+    return true;
+
+failed:
+    if (g_wp_log_wake_fd >= 0) close(g_wp_log_wake_fd);
+    if (g_wp_log_done_fd >= 0) close(g_wp_log_done_fd);
+    g_wp_log_wake_fd = -1;
+    g_wp_log_done_fd = -1;
+    return false;
+
+}
+
+
+void
+Log::stop()
+{
+
+    if (!s_running.load()) return;
+
+    // the thread drains the ring before it signals done
+    s_running.store(false);
+    signal_fd(g_wp_log_wake_fd);
+    wait_fd(g_wp_log_done_fd);
+
+}
+
+
+WP::Log::Stats
+Log::get_stats()
+{
+
+    WP::Log::Stats stats;
+    stats.records = g_wp_log_records;
+    stats.drops = s_drops.load(std::memory_order_relaxed);
+    return stats;
+
+}
+
+
+void
+Log::wake()
+{
+
+    if (s_idle.exchange(false)) signal_fd(g_wp_log_wake_fd);
+
+}
+
+
+void
+Log::run()
+{
+
+    for (;;) {
+        const bool running = s_running.load(std::memory_order_acquire);
+        const size_t head = s_head.load(std::memory_order_acquire);
+        size_t tail = s_tail.load(std::memory_order_relaxed);
+
+        for (; tail != head; ++tail) {
+            write(s_ring[tail & (WP_LOG_RING_SIZE - 1)]);
+            s_tail.store(tail + 1, std::memory_order_release);
+            g_wp_log_records++;
+        }
+
+        if (!running) break;
+
+        flush_buffer();
+
+        // sleep until the next record, unless one came in while the flag was not set yet
+        s_idle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s_head.load(std::memory_order_relaxed) == tail && s_running.load(std::memory_order_relaxed)) {
+            wait_fd(g_wp_log_wake_fd);
+        }
+        s_idle.store(false, std::memory_order_relaxed);
+    }
+
+    flush_buffer();
+    signal_fd(g_wp_log_done_fd);
+
+    // exiting a thread needs syscalls the filter does not allow, the process exit ends it
+    for (;;) wait_fd(g_wp_log_wake_fd);
+
+}
+
+
+void
+Log::write(const WP::Log::Record &record)
+{
+
+    const unsigned long long us = record.time / 1000;
+    append("[%llu.%06llu] ", us / 1000000, us % 1000000);
+
+    int src_code = record.src_slot;
+    int target_code = 0;
+    const char *src_name;
+    const char *target_name;
+
+    switch (record.type) {
+    case INPUT_DROPPED:
+        append("[Input] device=\"%s\" events dropped, resync after next report\n",
+               record.src->get_name().c_str());
+        break;
+
+    case INPUT_AXIS_IGNORED:
+        append("[Input] axis: code=\"%d\" value=\"%d\" -> ignored\n", src_code, record.src_value);
+        break;
+
+    case INPUT_BUTTON_IGNORED:
+        append("[Input] button: code=\"%d\" value=\"%d\" -> ignored\n", src_code, record.src_value);
+        break;
+
+    case AXIS_TO_AXIS:
+        src_name = get_axis_name(record.src, record.src_slot, &src_code);
+        target_name = get_axis_name(record.target, record.target_slot, &target_code);
+        append("[Input] axis: (name=\"%s\" code=\"%d\" value=\"%d\") -> [Output] axis: (name=\"%s\" code=\"%d\" value=\"%d\")\n",
+               src_name, src_code, record.src_value, target_name, target_code, record.target_value);
+        break;
+
+    case AXIS_TO_BUTTON:
+        src_name = get_axis_name(record.src, record.src_slot, &src_code);
+        target_name = get_button_name(record.target, record.target_slot, &target_code);
+        append("[Input] axis: (name=\"%s\" code=\"%d\" value=\"%d\") -> [Output] button: (name=\"%s\" code=\"%d\" down=\"%s\")\n",
+               src_name, src_code, record.src_value, target_name, target_code, record.target_value ? "true" : "false");
+        break;
+
+    case BUTTON_TO_BUTTON:
+        src_name = get_button_name(record.src, record.src_slot, &src_code);
+        target_name = get_button_name(record.target, record.target_slot, &target_code);
+        append("[Input] button: (name=\"%s\" code=\"%d\") -> [Output] button: (name=\"%s\" code=\"%d\") down=\"%s\"\n",
+               src_name, src_code, target_name, target_code, record.target_value ? "true" : "false");
+        break;
+
+    case BUTTON_TO_AXIS:
+        src_name = get_button_name(record.src, record.src_slot, &src_code);
+        target_name = get_axis_name(record.target, record.target_slot, &target_code);
+        append("[Input] button: (name=\"%s\" code=\"%d\") -> [Output] axis: (name=\"%s\" code=\"%d\") value=\"%d\"\n",
+               src_name, src_code, target_name, target_code, record.target_value);
+        break;
+
+    case OUTPUT_AXIS:
+        target_name = get_axis_name(record.target, record.target_slot, &target_code);
+        append("[Output] axis: (name=\"%s\" code=\"%d\" value=\"%d\")\n", target_name, target_code, record.target_value);
+        break;
+
+    case OUTPUT_BUTTON:
+        target_name = get_button_name(record.target, record.target_slot, &target_code);
+        append("[Output] button: (name=\"%s\" code=\"%d\" down=\"%s\")\n",
+               target_name, target_code, record.target_value ? "true" : "false");
+        break;
+
+    default:
+        append("[Log] unknown record type=\"%d\"\n", record.type);
+        break;
+    }
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,152 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "utils.h"
+
+
+#define WP_LOG_OFF    0 // no logging from the event path
+#define WP_LOG_INFO   1 // resyncs and ignored events
+#define WP_LOG_EVENTS 2 // every mapped event
+
+#ifndef WP_LOG_LEVEL
+#define WP_LOG_LEVEL WP_LOG_EVENTS
+#endif
+
+#define WP_LOG_RING_SIZE 4096 // records, power of two
+
+#if WP_LOG_LEVEL >= WP_LOG_INFO
+#define WP_LOG_INFO_RECORD(...) WP::Log::push(__VA_ARGS__)
+#else
+#define WP_LOG_INFO_RECORD(...) do {} while (0)
+#endif
+
+#if WP_LOG_LEVEL >= WP_LOG_EVENTS
+#define WP_LOG_EVENT_RECORD(...) WP::Log::push(__VA_ARGS__)
+#else
+#define WP_LOG_EVENT_RECORD(...) do {} while (0)
+#endif
+
+
+
+namespace WP {
+
+
+class Device;
+
+
+// verbose output of the event path: the event loop pushes fixed size records
+// into a single producer ring, a background thread formats and writes them.
+// The thread is started before the syscall filter, which covers it too, and
+// before the realtime setup, so it keeps the default scheduling policy and affinity.
+class Log
+{
+
+
+public:
+    enum Type : uint16_t {
+        INPUT_DROPPED,
+        INPUT_AXIS_IGNORED,
+        INPUT_BUTTON_IGNORED,
+        AXIS_TO_AXIS,
+        AXIS_TO_BUTTON,
+        BUTTON_TO_BUTTON,
+        BUTTON_TO_AXIS,
+        OUTPUT_AXIS,
+        OUTPUT_BUTTON
+    };
+
+    struct Record {
+        uint64_t time;
+        const WP::Device *src;
+        const WP::Device *target;
+        uint16_t type;
+        uint16_t src_slot; // event code for ignored events
+        uint16_t target_slot;
+        int32_t src_value;
+        int32_t target_value;
+    };
+
+    struct Stats {
+        uint64_t records;
+        uint64_t drops;
+    };
+
+
+    static bool start();
+    static void stop();
+
+    static void push(WP::Log::Type type, const WP::Device *src, uint16_t src_slot, int32_t src_value,
+                     const WP::Device *target = nullptr, uint16_t target_slot = 0, int32_t target_value = 0) {
+        if (!s_running.load(std::memory_order_relaxed)) return;
+
+        const size_t head = s_head.load(std::memory_order_relaxed);
+        if (head - s_tail.load(std::memory_order_acquire) >= WP_LOG_RING_SIZE) {
+            s_drops.store(s_drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        WP::Log::Record &record = s_ring[head & (WP_LOG_RING_SIZE - 1)];
+        record.time = WP::Utils::get_time();
+        record.src = src;
+        record.target = target;
+        record.type = type;
+        record.src_slot = src_slot;
+        record.target_slot = target_slot;
+        record.src_value = src_value;
+        record.target_value = target_value;
+
+        s_head.store(head + 1, std::memory_order_release);
+
+        // only the first record after the log thread went to sleep costs a syscall
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s_idle.load(std::memory_order_relaxed)) wake();
+    }
+
+    static WP::Log::Stats get_stats();
+
+
+private:
+    static WP::Log::Record s_ring[WP_LOG_RING_SIZE];
+    alignas(64) static std::atomic<size_t> s_head;  // written by the event loop
+    alignas(64) static std::atomic<size_t> s_tail;  // written by the log thread
+    alignas(64) static std::atomic<uint64_t> s_drops;
+    static std::atomic<bool> s_running;
+    static std::atomic<bool> s_idle; // the log thread waits for a wake up
+
+    static void wake();
+    static void run();
+    static void write(const WP::Log::Record &record);
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // LOG_H
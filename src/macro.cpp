@@ -0,0 +1,76 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "macro.h"
+
+
+
+namespace WP {
+
+
+
+Macro::Macro()
+{
+
+}
+
+
+Macro::~Macro()
+{
+
+}
+
+
+void
+Macro::add_step(uint8_t type, WP::EventSource *target, int32_t value, uint32_t delay)
+{
+
+    WP::Macro::Step step;
+    step.type = type;
+    step.target = target;
+    step.value = value;
+    step.delay = delay;
+    m_steps.push_back(step);
+
+}
+
+
+const std::vector<WP::Macro::Step> &
+Macro::get_steps() const
+{
+
+    return m_steps;
+
+}
+
+
+uint64_t
+Macro::get_duration() const
+{
+
+    uint64_t duration = 0;
+    for (size_t i = 0, s = m_steps.size(); i < s; ++i) {
+        duration += m_steps[i].delay;
+    }
+    return duration;
+
+}
+
+
+
+} // namespace WP
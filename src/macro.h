@@ -0,0 +1,79 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+#define WP_MACRO_MAX_STEPS 256
+
+
+
+namespace WP {
+
+
+class EventSource;
+
+
+// timed sequence of output button presses, releases and axis values started by a button,
+// built by the config and compiled into MapMacroSteps by the map
+class Macro
+{
+
+
+public:
+    struct Step {
+        enum Type : uint8_t {
+            PRESS,
+            RELEASE,
+            AXIS
+        };
+
+        uint8_t type;
+        WP::EventSource *target; // button or axis of the output device
+        int32_t value;  // axis value, after invert like button to axis values
+        uint32_t delay; // ms after the previous step
+    };
+
+
+    Macro();
+    ~Macro();
+
+    void add_step(uint8_t type, WP::EventSource *target, int32_t value, uint32_t delay);
+
+    const std::vector<WP::Macro::Step> &get_steps() const;
+    uint64_t get_duration() const; // ms
+
+
+private:
+    std::vector<WP::Macro::Step> m_steps;
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // MACRO_H
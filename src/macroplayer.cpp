@@ -0,0 +1,191 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "macroplayer.h"
+#include "map.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+#define MS_TO_NS(ms) ((uint64_t) (ms) * 1000000ULL)
+
+
+
+namespace WP {
+
+
+
+MacroPlayer::MacroPlayer()
+{
+
+    m_map = nullptr;
+    m_listener = nullptr;
+    m_deadline = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+}
+
+
+MacroPlayer::~MacroPlayer()
+{
+
+}
+
+
+void
+MacroPlayer::init(const WP::Map *map)
+{
+
+    m_map = map;
+    m_running.clear();
+    m_deadline = 0;
+
+    m_runs.resize(map->get_macro_count());
+    for (size_t i = 0, s = m_runs.size(); i < s; ++i) {
+        m_runs[i].step = map->get_macros()[i].end;
+        m_runs[i].time = 0;
+    }
+
+}
+
+
+void
+MacroPlayer::set_listener(WP::MacroPlayer::Listener *listener)
+{
+
+    m_listener = listener;
+
+}
+
+
+void
+MacroPlayer::start(uint16_t macro, uint64_t now)
+{
+
+    assert(m_listener != nullptr && macro < m_runs.size());
+
+    const WP::MapMacro &steps = m_map->get_macros()[macro];
+    WP::MacroPlayer::Run &run = m_runs[macro];
+
+    if (run.step < steps.end) {
+        m_stats.ignored++;
+        return;
+    }
+
+    m_stats.runs++;
+    run.step = steps.begin;
+    run.time = now + MS_TO_NS(m_map->get_macro_steps()[steps.begin].delay);
+
+    // steps without a delay run right away, the rest from the event loop's timer
+    if (play(macro, now, false)) {
+        m_running.push_back(macro);
+        update_deadline();
+    }
+
+}
+
+
+void
+MacroPlayer::expire(uint64_t now)
+{
+
+    if (m_deadline == 0 || now < m_deadline) return;
+
+    for (size_t i = 0; i < m_running.size();) {
+        if (play(m_running[i], now, true)) {
+            ++i;
+        } else {
+            m_running[i] = m_running.back();
+            m_running.pop_back();
+        }
+    }
+
+    update_deadline();
+
+}
+
+
+uint64_t
+MacroPlayer::get_deadline() const
+{
+
+    return m_deadline;
+
+}
+
+
+const WP::MacroPlayer::Stats &
+MacroPlayer::get_stats() const
+{
+
+    return m_stats;
+
+}
+
+
+const WP::Histogram &
+MacroPlayer::get_timing() const
+{
+
+    return m_timing;
+
+}
+
+
+bool
+MacroPlayer::play(uint16_t macro, uint64_t now, bool timed)
+{
+
+    const WP::MapMacro &steps = m_map->get_macros()[macro];
+    const WP::MapMacroStep *step = m_map->get_macro_steps();
+    WP::MacroPlayer::Run &run = m_runs[macro];
+
+    while (run.step < steps.end && run.time <= now) {
+        // how late the step is against its schedule
+        if (timed) m_timing.add(now - run.time);
+
+        m_stats.steps++;
+        m_listener->onMacroStep(step[run.step]);
+
+        // delays add up from the scheduled times, so a late step does not shift the rest
+        if (++run.step < steps.end) {
+            run.time += MS_TO_NS(step[run.step].delay);
+        }
+    }
+
+    return run.step < steps.end;
+
+}
+
+
+void
+MacroPlayer::update_deadline()
+{
+
+    m_deadline = 0;
+    for (size_t i = 0, s = m_running.size(); i < s; ++i) {
+        const uint64_t time = m_runs[m_running[i]].time;
+        if (m_deadline == 0 || time < m_deadline) m_deadline = time;
+    }
+
+}
+
+
+
+} // namespace WP
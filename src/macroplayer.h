@@ -0,0 +1,97 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef MACROPLAYER_H
+#define MACROPLAYER_H
+
+#include "histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+
+namespace WP {
+
+
+
+class Map;
+struct MapMacroStep;
+class MacroPlayer
+{
+
+
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() { }
+        virtual void onMacroStep(const WP::MapMacroStep &step) = 0;
+    };
+
+    struct Stats {
+        uint64_t runs;    // macros started
+        uint64_t ignored; // starts while the macro was still running
+        uint64_t steps;
+    };
+
+
+    MacroPlayer();
+    ~MacroPlayer();
+
+    void init(const WP::Map *map);
+    void set_listener(WP::MacroPlayer::Listener *listener);
+
+    void start(uint16_t macro, uint64_t now);
+    void expire(uint64_t now);
+
+    // time of the next step of all running macros, 0 if none
+    uint64_t get_deadline() const;
+
+    const WP::MacroPlayer::Stats &get_stats() const;
+    const WP::Histogram &get_timing() const;
+
+
+private:
+    struct Run {
+        uint32_t step; // next step, the end of the macro if it is not running
+        uint64_t time; // scheduled time of the next step
+    };
+
+    const WP::Map *m_map;
+    WP::MacroPlayer::Listener *m_listener;
+    std::vector<WP::MacroPlayer::Run> m_runs; // by macro
+    std::vector<uint16_t> m_running;
+    uint64_t m_deadline;
+    WP::MacroPlayer::Stats m_stats;
+    WP::Histogram m_timing;
+
+    bool play(uint16_t macro, uint64_t now, bool timed);
+    void update_deadline();
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // MACROPLAYER_H
@@ -45,9 +45,12 @@
 #include "button.h"
 #include "utils.h"
 #include "application.h"
-
-
-#include "3rdparty/json/json.hpp"
+#include "eventloop.h"
+#include "realtime.h"
+#include "arena.h"
+#include "config.h"
+#include "compiledmap.h"
+#include "log.h"
 
 
 #define ArchField offsetof(struct seccomp_data, arch)
@@ -56,552 +59,170 @@
     BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_ALLOW)
 
 
-enum wp_json_type {
-    JSON_TYPE_STRING,
-    JSON_TYPE_BOOL,
-    JSON_TYPE_NUMBER
-};
-
-
-namespace WP {
-
-
-class DeviceConfig {
-public:
-    DeviceConfig() { }
-    ~DeviceConfig()
-    {
-        DELETE_ALL(buttons);
-        DELETE_ALL(axes);
-    }
-
-    std::string name;
-    int32_t vendor;
-    int32_t product;
-    int32_t version;
-    std::vector<WP::Axis*> axes;
-    std::vector<WP::Button*> buttons;
-
-};
-
-
-}
-
-
 static volatile bool g_stop = false;
 
 
-static bool
-json_get_value(const nlohmann::json &json, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
-{
-
-    if (json.is_null()) {
-        switch (type) {
-        case JSON_TYPE_STRING: (*(std::string*) ptr) = ""; break;
-        case JSON_TYPE_BOOL: (*(bool*) ptr) = false; break;
-        case JSON_TYPE_NUMBER: (*(int32_t*) ptr) = 0; break;
-        default: return false;
-        }
-
-        return true;
-    }
-
-    switch (type) {
-    case JSON_TYPE_STRING:
-        if (json.type() != nlohmann::json::value_t::string) {
-            return false;
-        }
-        break;
-    case JSON_TYPE_BOOL:
-        if (json.type() != nlohmann::json::value_t::boolean) {
-            return false;
-        }
-        break;
-    case JSON_TYPE_NUMBER:
-        if (json.type() != nlohmann::json::value_t::number_integer && json.type() != nlohmann::json::value_t::number_unsigned) {
-            return false;
-        }
-
-        if (json.type() == nlohmann::json::value_t::number_integer) {
-            if (((int64_t) json) > max || ((int64_t) json) < min) {
-                return false;
-            }
-        } else {
-            if (max < 0) {
-                return false;
-            } else if (min >= 0 && ((uint64_t) json) < min) {
-                return false;
-            } else if (((uint64_t) json) > max) {
-                return false;
-            }
-        }
-        break;
-    default: return false;
-    }
-
-    switch (json.type()) {
-    case nlohmann::json::value_t::string: (*(std::string*) ptr) = json; break;
-    case nlohmann::json::value_t::boolean: (*(bool*) ptr) = json; break;
-    case nlohmann::json::value_t::number_integer:
-    case nlohmann::json::value_t::number_unsigned: (*(int32_t*) ptr) = json; break;
-    default: return false;
-    }
-
-    return true;
-
-}
-
 
-static bool
-json_get_value_from_obj(const nlohmann::json &obj, const std::string &key, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
-{
-
-    const auto it = obj.find(key);
-    if (it == obj.end()) return false;
-    return json_get_value(*it, type, ptr, min, max);
-
-}
-
-
-static bool
-json_find_value(const nlohmann::json &obj, const std::vector<std::string> &path, wp_json_type type, void *ptr, int32_t min = INT32_MIN, int32_t max = INT32_MAX)
-{
-
-    if (!obj.is_object()) return false;
-
-    nlohmann::json current_obj = obj;
-    for (size_t i = 0, s = path.size(); i < s; ++i) {
-        if (i == s - 1) {
-            return json_get_value_from_obj(current_obj, path[i], type, ptr, min, max);
-        } else {
-            const auto it = current_obj.find(path[i]);
-            if (it == current_obj.end()) return false;
-            if (!(*it).is_object()) return false;
-            current_obj = *it;
-        }
-    }
-
-    return false;
-
-}
-
-
-template <typename T>
-static T *
-get_event_source_by_code(const std::vector<T*> &vec, uint16_t code)
-{
-
-    for (size_t i = 0, s = vec.size(); i < s; ++i) {
-        T *e = vec[i];
-        if (e->get_code() == code) return e;
-    }
-    return nullptr;
-
-}
-
-
-template <typename T>
-static T *
-get_event_source_by_name(const std::vector<T*> &vec, const std::string &name)
-{
-
-    for (size_t i = 0, s = vec.size(); i < s; ++i) {
-        T *e = vec[i];
-        if (e->get_name().compare(name) == 0) return e;
-    }
-    return nullptr;
-
-}
-
-
-
-static bool
-parse_axes(nlohmann::json &dev_obj, std::vector<WP::Axis*> *axes)
+static void
+print_map_pretty(int m, const std::string &in, const std::string &out)
 {
 
-    const auto _axes_array = dev_obj.find("axes");
-    if (_axes_array == dev_obj.end()) return false;
-
-    const auto axes_array = *_axes_array;
-    if (axes_array.is_null()) return true;
-    if (!axes_array.is_array()) {
-        printf("invalid or missing axes element\n");
-        return false;
-    }
-
-    for (auto it = axes_array.begin(); it != axes_array.end(); ++it) {
-        const auto axis_obj = *it;
-
-        std::string name;
-        int32_t code;
-        int32_t min;
-        int32_t max;
-        bool invert;
-
-
-        if (!json_find_value(axis_obj, { "name" }, JSON_TYPE_STRING, (void*) &name) ||
-                !json_find_value(axis_obj, { "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, ABS_MAX) ||
-                !json_find_value(axis_obj, { "min" }, JSON_TYPE_NUMBER, (void*) &min, INT32_MIN, INT32_MAX) ||
-                !json_find_value(axis_obj, { "max" }, JSON_TYPE_NUMBER, (void*) &max, INT32_MIN, INT32_MAX) ||
-                !json_find_value(axis_obj, { "invert" }, JSON_TYPE_BOOL, (void*) &invert))
-        {
-            printf("invalid axis:\n%s\n", axis_obj.dump().c_str());
-            return false;
-        }
-
-
-        if (get_event_source_by_code(*axes, code) != nullptr) {
-            printf("duplicate axis code %d:\n%s\n", code, axis_obj.dump().c_str());
-            return false;
-        }
-
-
-        WP::Axis *axis = new WP::Axis;
-        axis->set_code(code);
-        axis->set_min(min);
-        axis->set_max(max);
-        axis->set_name(name);
-        axis->set_invert(invert);
-
-        axes->push_back(axis);
-    }
-
-    return true;
+    const int c = (m - in.length()) - 3;
+    printf("%*s\"%s\" -> \"%s\"\n", c > 0 ? c : 1, " ", in.c_str(), out.c_str());
 
 }
 
 
-static bool
-parse_buttons(nlohmann::json &dev_obj, std::vector<WP::Button*> *buttons)
+static void
+print_map_entry(const WP::MapEntry *entry, int m)
 {
 
-    const auto _button_array = dev_obj.find("buttons");
-    if (_button_array == dev_obj.end()) return false;
-
-    const auto button_array = *_button_array;
-    if (button_array.is_null()) return true;
-    if (!button_array.is_array()) {
-        printf("invalid or missing buttons element\n");
-        return false;
-    }
-
-    for (auto it = button_array.begin(); it != button_array.end(); ++it) {
-        const auto button_obj = *it;
-
-        std::string name;
-        int32_t code;
-
-        if (!json_find_value(button_obj, { "name" }, JSON_TYPE_STRING, (void*) &name) ||
-                !json_find_value(button_obj, { "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, KEY_MAX))
-        {
-            printf("invalid button:\n%s\n", button_obj.dump().c_str());
-            return false;
-        }
-
-        if (get_event_source_by_code(*buttons, code) != nullptr) {
-            printf("duplicate button code %d:\n%s\n", code, button_obj.dump().c_str());
-            return false;
-        }
-
-        WP::Button *button = new WP::Button();
-        button->set_code(code);
-        button->set_name(name);
-
-        buttons->push_back(button);
-    }
-
-    return true;
-
-}
-
-
-
-static bool
-get_device_info(nlohmann::json &json, WP::DeviceConfig *in, WP::DeviceConfig *out)
-{
+    const std::string in = entry->get_src()->get_name();
+    const std::string out = entry->get_target()->get_name();
+    const int c = (m - in.length()) - 3;
 
-    if (!json_find_value(json, { "input", "name" }, JSON_TYPE_STRING, (void*) &in->name) ||
-            !json_find_value(json, { "input", "vendor" }, JSON_TYPE_NUMBER, (void*) &in->vendor, 0, INT32_MAX) ||
-            !json_find_value(json, { "input", "product" }, JSON_TYPE_NUMBER, (void*) &in->product, 0, INT32_MAX) ||
-            !json_find_value(json, { "input", "version" }, JSON_TYPE_NUMBER, (void*) &in->version, 0, INT32_MAX))
-    {
-        printf("invalid input device\n");
-        return false;
+    if (entry->get_macro() != nullptr) {
+        printf("%*s\"%s\" -> macro of %zu steps, %llu ms\n", c > 0 ? c : 1, " ", in.c_str(),
+               entry->get_macro()->get_steps().size(), (unsigned long long) entry->get_macro()->get_duration());
+        return;
     }
 
-    if (!json_find_value(json, { "output", "name" }, JSON_TYPE_STRING, (void*) &out->name) ||
-            !json_find_value(json, { "output", "vendor" }, JSON_TYPE_NUMBER, (void*) &out->vendor, 0, INT32_MAX) ||
-            !json_find_value(json, { "output", "product" }, JSON_TYPE_NUMBER, (void*) &out->product, 0, INT32_MAX) ||
-            !json_find_value(json, { "output", "version" }, JSON_TYPE_NUMBER, (void*) &out->version, 0, INT32_MAX))
-    {
-        printf("invalid output device\n");
-        return false;
+    const char *kind = "";
+    if (entry->get_curve() != nullptr) {
+        kind = " (curve)";
+    } else if (entry->get_op().code == WP::MapOp::AXIS_TO_COMBINE) {
+        static const char *modes[] = { " (sum)", " (difference)", " (max)" };
+        kind = modes[entry->get_combine_mode()];
+    } else if (entry->get_op().code == WP::MapOp::BUTTON_TO_CHORD) {
+        kind = " (chord)";
     }
 
-
-    const auto input = json.find("input");
-    const auto output = json.find("output");
-    if (input == json.end() || output == json.end() || !(*input).is_object() || !(*output).is_object()) {
-        return false;
-    }
-    return parse_buttons(*input, &in->buttons) && parse_buttons(*output, &out->buttons) && parse_axes(*input, &in->axes) && parse_axes(*output, &out->axes);
+    printf("%*s\"%s\" -> \"%s\"%s\n", c > 0 ? c : 1, " ", in.c_str(), out.c_str(), kind);
 
 }
 
 
-static WP::EventSource *
-parse_map_entry_event_source(const nlohmann::json &entry, bool src, const WP::DeviceConfig *in, const WP::DeviceConfig *out)
+static void
+print_config(const WP::Map *map, const WP::Config *config)
 {
 
-    WP::EventSource *ret = nullptr;
-    const std::string key = src ? "src" : "target";
-    std::string name;
-    std::string type;
-    int32_t code = 0;
+    for (size_t d = 0, dS = config->inputs.size(); d < dS; ++d) {
+        const WP::DeviceConfig *in = config->inputs[d];
 
+        printf("%s -> %s\n", in->name.c_str(), config->output.name.c_str());
 
-    if (!json_find_value(entry, { key, "type" }, JSON_TYPE_STRING, (void*) &type)) {
-        printf("missing %s type:\n%s\n", key.c_str(), entry.dump().c_str());
-        return nullptr;
-    } else if (type.compare("button") != 0 && type.compare("axis") != 0) {
-        printf("invalid %s type: %s\n%s\n", key.c_str(), type.c_str(), entry.dump().c_str());
-        return nullptr;
-    }
+        const int m = in->name.length() + 1;
 
+        for (size_t i = 0, s = in->axes.size(); i < s; ++i) {
+            WP::Axis *src = in->axes[i];
 
-    const bool found_code = json_find_value(entry, { key, "code" }, JSON_TYPE_NUMBER, (void*) &code, 0, INT32_MAX);
-    const bool found_name = json_find_value(entry, { key, "name" }, JSON_TYPE_STRING, (void*) &name);
-
-
-    if (!found_code && !found_name) {
-        printf("missing %s code or name:\n%s\n", key.c_str(), entry.dump().c_str());
-        return nullptr;
-    }
-
-
-    if (type.compare("button") == 0) {
-        if (found_name) {
-            ret = get_event_source_by_name(src ? in->buttons : out->buttons, name);
-            if (ret == nullptr) {
-                printf("invalid %s button name: %s\n%s\n", key.c_str(), name.c_str(), entry.dump().c_str());
-            }
-        } else {
-            ret = get_event_source_by_code(src ? in->buttons : out->buttons, code);
-            if (ret == nullptr) {
-                printf("invalid %s button code: %d\n%s\n", key.c_str(), code, entry.dump().c_str());
-            }
-        }
-    } else if (type.compare("axis") == 0) {
-        if (found_name) {
-            ret = get_event_source_by_name(src ? in->axes : out->axes, name);
-            if (ret == nullptr) {
-                printf("invalid %s axis name: %s\n%s\n", key.c_str(), name.c_str(), entry.dump().c_str());
-            }
-        } else {
-            ret = get_event_source_by_code(src ? in->axes : out->axes, code);
-            if (ret == nullptr) {
-                printf("invalid %s axis code: %d\n%s\n", key.c_str(), code, entry.dump().c_str());
+            size_t count;
+            const WP::MapEntry *entries = map->get_entries(src, &count);
+            for (size_t j = 0; j < count; ++j) {
+                print_map_entry(&entries[j], m);
             }
         }
-    } else {
-        printf("invalid src type: %s\n", type.c_str());
-        return nullptr;
-    }
-
-    return ret;
-
-}
-
-
-static WP::MapEntry *
-parse_map_entry(const nlohmann::json &entry_obj, const WP::DeviceConfig *in, const WP::DeviceConfig *out)
-{
 
-    if (!entry_obj.is_object()) {
-        printf("invalid map entry:\n%s\n", entry_obj.dump().c_str());
-        return nullptr;
-    }
-
-
-    WP::EventSource *src = parse_map_entry_event_source(entry_obj, true, in, out);
-    WP::EventSource *target = parse_map_entry_event_source(entry_obj, false, in, out);
-    WP::MapEntry::Data *data = nullptr;
-
-    if (src == nullptr || target == nullptr) {
-        goto failed;
-    }
-
-    if (src->get_type() == WP::EventSource::TYPE_AXIS) {
-        if (target->get_type() == WP::EventSource::TYPE_BUTTON) {
-            int32_t range_start;
-            int32_t range_end;
-
-            if (!json_find_value(entry_obj, { "src", "range", "start" }, JSON_TYPE_NUMBER, (void*) &range_start, INT32_MIN, INT32_MAX) ||
-                    !json_find_value(entry_obj, { "src", "range", "end" }, JSON_TYPE_NUMBER, (void*) &range_end, INT32_MIN, INT32_MAX))
-            {
-                printf("missing or invalid axis to button range:\n%s\n", entry_obj.dump().c_str());
-                goto failed;
-            }
+        for (size_t i = 0, s = in->buttons.size(); i < s; ++i) {
+            WP::Button *src = in->buttons[i];
 
-            if (range_end > range_start) {
-                printf("invalid axis to button range: start > end\n%s\n", entry_obj.dump().c_str());
-                goto failed;
+            size_t count;
+            const WP::MapEntry *entries = map->get_entries(src, &count);
+            for (size_t j = 0; j < count; ++j) {
+                print_map_entry(&entries[j], m);
             }
-
-            data = new WP::AxisToButtonData(range_start, range_end);
         }
-    } else if (src->get_type() == WP::EventSource::TYPE_BUTTON) {
-        if (target->get_type() == WP::EventSource::TYPE_AXIS) {
-            int32_t value_released;
-            int32_t value_pressed;
-
-            if (!json_find_value(entry_obj, { "target", "values", "released" }, JSON_TYPE_NUMBER, (void*) &value_released, INT32_MIN, INT32_MAX) ||
-                    !json_find_value(entry_obj, { "target", "values", "pressed" }, JSON_TYPE_NUMBER, (void*) &value_pressed, INT32_MIN, INT32_MAX))
-            {
-                printf("missing or invalid button to axis values:\n%s\n", entry_obj.dump().c_str());
-                goto failed;
-            }
-
-            data = new WP::ButtonToAxisData(value_released, value_pressed);
-        }
-    }
-
-    return new WP::MapEntry(src, target, data);
-
-failed:
-    delete data;
-
-    return nullptr;
 
-}
-
-
-static bool
-parse_map(nlohmann::json &json, WP::Map *map, const WP::DeviceConfig *in, const WP::DeviceConfig *out)
-{
-
-    const auto _map_array = json.find("map");
-    if (_map_array == json.end()) {
-        printf("missing map element\n");
-        return false;
-    }
-
-    const auto map_array = *_map_array;
-    if (!map_array.is_array()) {
-        printf("invalid map element\n");
-        return false;
+        printf("\n");
     }
 
-
-    for (auto it = map_array.begin(); it != map_array.end(); ++it) {
-        WP::MapEntry *entry = parse_map_entry(*it, in, out);
-        if (entry == nullptr) return false;
-        map->add(entry);
+    if (WP::Application::get_verbose()) {
+        const WP::Arena::Stats &arena = config->arena.get_stats();
+        printf("[Config] objects=\"%llu\" allocations=\"%llu\" size=\"%llu bytes\"\n",
+               (unsigned long long) arena.objects, (unsigned long long) arena.blocks, (unsigned long long) arena.bytes);
     }
 
-    return true;
+    printf("\n");
 
 }
 
 
-static bool
-parse_config(const char *file, WP::Map *map, WP::DeviceConfig *in, WP::DeviceConfig *out)
-{
-
-    std::ifstream ifs(file);
-    std::string str;
-
-    if (ifs.fail()) {
-        printf("\"%s\": %s\n", file, strerror(errno));
-        return false;
-    }
-
-    ifs.seekg(0, std::ios::end);
-    if (ifs.tellg() < 1) {
-        printf("empty config...\n");
-        return false;
-    }
-    str.reserve(ifs.tellg());
-    ifs.seekg(0, std::ios::beg);
-
-    str.assign((std::istreambuf_iterator<char>(ifs)),
-                std::istreambuf_iterator<char>());
-    if (str.length() < 1) {
-        printf("empty config\n");
-        return false;
-    }
-
-
-    try {
-        auto json = nlohmann::json::parse(str);
-        if (!json.is_object()) {
-            return false;
-        }
-
-        if (!get_device_info(json, in, out)) return false;
-        if (!parse_map(json, map, in, out)) return false;
-    } catch (const std::exception &e) {
-        printf("%s\n", e.what());
-        return false;
-    }
-
-    return true;
-
-}
-
-
-
 static void
-print_map_pretty(int m, const std::string &in, const std::string &out)
+print_stats(const WP::EventLoop *loop, const WP::TargetDevice *target)
 {
 
-    const int c = (m - in.length()) - 3;
-    printf("%*s\"%s\" -> \"%s\"\n", c > 0 ? c : 1, " ", in.c_str(), out.c_str());
-
-}
-
-
-static void
-print_map_entry(const WP::MapEntry *entry, int m)
-{
-
-    const std::string in = entry->get_src()->get_name();
-    const std::string out = entry->get_target()->get_name();
-    const int c = (m - in.length()) - 3;
-    printf("%*s\"%s\" -> \"%s\"\n", c > 0 ? c : 1, " ", in.c_str(), out.c_str());
-
-}
-
-
-static void
-print_config(const WP::Map *map, const WP::DeviceConfig *in, const WP::DeviceConfig *out)
-{
-
-    printf("%s -> %s\n", in->name.c_str(), out->name.c_str());
-
-    const int m = in->name.length() + 1;
-
-    for (size_t i = 0, s = in->axes.size(); i < s; ++i) {
-        WP::Axis *src = in->axes[i];
-
-        auto entries = map->get_entries_for_src(src);
-        if (entries == nullptr) continue;
-        for (size_t j = 0, jS = entries->size(); j < jS; ++j) {
-            print_map_entry((*entries)[j], m);
-        }
-    }
-
-    for (size_t i = 0, s = in->buttons.size(); i < s; ++i) {
-        WP::Button *src = in->buttons[i];
-
-        auto entries = map->get_entries_for_src(src);
-        if (entries == nullptr) continue;
-        for (size_t j = 0, jS = entries->size(); j < jS; ++j) {
-            print_map_entry((*entries)[j], m);
-        }
-    }
+    for (size_t i = 0, c = loop->get_source_count(); i < c; ++i) {
+        const WP::SourceDevice *src = loop->get_source_at(i);
+        const WP::SourceDevice::Stats &in = src->get_stats();
+
+        printf("[Input] device=\"%s\" reads=\"%llu\" events=\"%llu\" frames=\"%llu\" events/read=\"%.2f\" drops=\"%llu\"\n",
+               src->get_name().c_str(),
+               (unsigned long long) in.reads, (unsigned long long) in.events, (unsigned long long) in.frames,
+               in.reads > 0 ? (double) in.events / in.reads : 0.0, (unsigned long long) in.drops);
+        printf("[Input] device=\"%s\" ignored events=\"%llu\" frames without mapped events=\"%llu\" filtered events=\"%llu\" settled=\"%llu\"\n",
+               src->get_name().c_str(), (unsigned long long) in.ignored, (unsigned long long) in.empty_frames,
+               (unsigned long long) in.filtered, (unsigned long long) in.settled);
+
+        const WP::Histogram &latency = src->get_latency();
+        printf("[Input] device=\"%s\" latency: p50=\"%.1f us\" p99=\"%.1f us\" p99.9=\"%.1f us\" max=\"%.1f us\"\n",
+               src->get_name().c_str(),
+               latency.get_percentile(0.5) / 1000.0, latency.get_percentile(0.99) / 1000.0,
+               latency.get_percentile(0.999) / 1000.0, latency.get_max() / 1000.0);
+    }
+
+    const WP::EventLoop::Stats &loop_stats = loop->get_stats();
+    if (loop_stats.reconnects > 0) {
+        printf("[Input] reconnects=\"%llu\" avg latency=\"%.3f ms\" max latency=\"%.3f ms\"\n",
+               (unsigned long long) loop_stats.reconnects,
+               loop_stats.reconnect_time_total / 1000000.0 / loop_stats.reconnects,
+               loop_stats.reconnect_time_max / 1000000.0);
+    }
+
+    if (loop_stats.sleeps > 0) {
+        printf("[Loop] spin=\"%.3f ms\" events while spinning=\"%llu\" sleep=\"%.3f ms\" sleeps=\"%llu\"\n",
+               loop_stats.spin_time / 1000000.0, (unsigned long long) loop_stats.spin_hits,
+               loop_stats.sleep_time / 1000000.0, (unsigned long long) loop_stats.sleeps);
+    }
+
+    const WP::TargetDevice::Stats &out = target->get_stats();
+    printf("[Output] frames=\"%llu\" events=\"%llu\" syscalls saved=\"%llu\" saved/frame=\"%.2f\"\n",
+           (unsigned long long) out.frames, (unsigned long long) out.events, (unsigned long long) out.syscalls_saved,
+           out.frames > 0 ? (double) out.syscalls_saved / out.frames : 0.0);
+    printf("[Output] unchanged values suppressed=\"%llu\"\n", (unsigned long long) out.suppressed);
+    if (out.combine_inputs > 0) {
+        printf("[Output] combined axes: input changes=\"%llu\" updates=\"%llu\"\n",
+               (unsigned long long) out.combine_inputs, (unsigned long long) out.combine_updates);
+    }
+    const WP::Chords::Stats &chords = target->get_chords().get_stats();
+    if (chords.held > 0) {
+        const WP::Histogram &delay = target->get_chords().get_delay();
+        printf("[Output] chords=\"%llu\" held presses=\"%llu\" timeouts=\"%llu\" taps=\"%llu\" suppressed=\"%llu\"\n",
+               (unsigned long long) chords.triggers, (unsigned long long) chords.held, (unsigned long long) chords.timeouts,
+               (unsigned long long) chords.taps, (unsigned long long) chords.suppressed);
+        printf("[Output] chord button delay: p50=\"%.1f ms\" p99=\"%.1f ms\" max=\"%.1f ms\"\n",
+               delay.get_percentile(0.5) / 1000000.0, delay.get_percentile(0.99) / 1000000.0, delay.get_max() / 1000000.0);
+    }
+    const WP::MacroPlayer::Stats &macros = target->get_macros().get_stats();
+    if (macros.runs > 0) {
+        const WP::Histogram &timing = target->get_macros().get_timing();
+        printf("[Output] macros=\"%llu\" ignored while running=\"%llu\" steps=\"%llu\"\n",
+               (unsigned long long) macros.runs, (unsigned long long) macros.ignored, (unsigned long long) macros.steps);
+        printf("[Output] macro steps late: p50=\"%.1f us\" p99=\"%.1f us\" max=\"%.1f us\"\n",
+               timing.get_percentile(0.5) / 1000.0, timing.get_percentile(0.99) / 1000.0, timing.get_max() / 1000.0);
+    }
+    printf("[Output] lookup tables=\"%llu\" size=\"%llu bytes\"\n",
+           (unsigned long long) out.tables, (unsigned long long) out.table_bytes);
+
+#if WP_LOG_LEVEL > WP_LOG_OFF
+    const WP::Log::Stats log = WP::Log::get_stats();
+    printf("[Log] records=\"%llu\" dropped=\"%llu\"\n",
+           (unsigned long long) log.records, (unsigned long long) log.drops);
+#endif
 
-    printf("\n\n");
+    const WP::Histogram &latency = target->get_latency();
+    printf("[Output] end-to-end latency: p50=\"%.1f us\" p99=\"%.1f us\" p99.9=\"%.1f us\" max=\"%.1f us\"\n",
+           latency.get_percentile(0.5) / 1000.0, latency.get_percentile(0.99) / 1000.0,
+           latency.get_percentile(0.999) / 1000.0, latency.get_max() / 1000.0);
 
 }
 
@@ -623,16 +244,35 @@ install_syscall_filter()
         ALLOW_SYSCALL(fstat),
         ALLOW_SYSCALL(exit_group),
         ALLOW_SYSCALL(open),
+        ALLOW_SYSCALL(openat),
+        ALLOW_SYSCALL(getdents64),
+        ALLOW_SYSCALL(newfstatat),
         ALLOW_SYSCALL(read),
         ALLOW_SYSCALL(write),
+        ALLOW_SYSCALL(writev),
         ALLOW_SYSCALL(ioctl),
         ALLOW_SYSCALL(close),
         ALLOW_SYSCALL(lseek),
         ALLOW_SYSCALL(rt_sigreturn),
         ALLOW_SYSCALL(poll),
+        ALLOW_SYSCALL(epoll_create1),
+        ALLOW_SYSCALL(epoll_ctl),
+        ALLOW_SYSCALL(epoll_wait),
+        ALLOW_SYSCALL(epoll_pwait),
+        ALLOW_SYSCALL(timerfd_create),
+        ALLOW_SYSCALL(timerfd_settime),
+        ALLOW_SYSCALL(clock_gettime),
+        ALLOW_SYSCALL(inotify_init1),
+        ALLOW_SYSCALL(inotify_add_watch),
+        ALLOW_SYSCALL(sched_get_priority_min),
+        ALLOW_SYSCALL(sched_get_priority_max),
+        ALLOW_SYSCALL(sched_setscheduler),
+        ALLOW_SYSCALL(sched_setaffinity),
+        ALLOW_SYSCALL(mlockall),
         ALLOW_SYSCALL(nanosleep),
         ALLOW_SYSCALL(dup),
         ALLOW_SYSCALL(fcntl),
+        ALLOW_SYSCALL(futex), // contended stdio and malloc locks, shared with the log thread
 
         // and if we don't match above, die
         BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_TRAP), // TRAP
@@ -646,8 +286,9 @@ install_syscall_filter()
         perror("prctl(NO_NEW_PRIVS)");
         goto failed;
     }
-    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog)) {
-        perror("prctl(SECCOMP)");
+    // TSYNC: the log thread is already running and gets the same filter
+    if (syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_TSYNC, &prog) != 0) {
+        perror("seccomp(SECCOMP_SET_MODE_FILTER)");
         goto failed;
     }
     return 0;
@@ -671,11 +312,30 @@ sig_handler(int sig)
 }
 
 
+static bool
+get_int_arg(int argc, char **argv, int i, int *value)
+{
+
+    if (i + 1 >= argc) return false;
+
+    char *end = nullptr;
+    errno = 0;
+    const long v = strtol(argv[i + 1], &end, 10);
+    if (errno != 0 || end == argv[i + 1] || *end != '\0' || v < INT32_MIN || v > INT32_MAX) {
+        return false;
+    }
+
+    *value = v;
+    return true;
+
+}
+
+
 static void
 print_usage(const char *cmd)
 {
 
-    printf("usage: %s [--verbose] --config FILE\n", cmd);
+    printf("usage: %s [--verbose] [--realtime [--priority N] [--cpu N]] [--spin USEC] [--table-size N] [--table-budget KB] --config FILE\n", cmd);
 
 }
 
@@ -686,14 +346,43 @@ int main(int argc, char **argv)
 
     signal(SIGINT, sig_handler);
 
-#ifndef NO_SECCOMP
-    install_syscall_filter();
-#endif
-
     const char *file = nullptr;
+    bool realtime = false;
+    int priority = WP_REALTIME_PRIORITY;
+    int cpu = -1;
+    int spin = 0;
+    int table_size = WP_TABLE_MAX_SIZE;
+    int table_budget = WP_TABLE_BUDGET / 1024;
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
             WP::Application::set_verbose(true);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(argv[i], "--priority") == 0) {
+            if (!get_int_arg(argc, argv, i, &priority)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cpu") == 0) {
+            if (!get_int_arg(argc, argv, i, &cpu) || cpu < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--spin") == 0) {
+            if (!get_int_arg(argc, argv, i, &spin) || spin < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--table-size") == 0) {
+            if (!get_int_arg(argc, argv, i, &table_size) || table_size < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--table-budget") == 0) {
+            if (!get_int_arg(argc, argv, i, &table_budget) || table_budget < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
         } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
             if (i + 1 >= argc) {
                 print_usage(argv[0]);
@@ -709,41 +398,78 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // before the syscall filter, it does not allow creating threads, and before the
+    // realtime setup, which only applies to this thread
+    if (WP::Application::get_verbose()) {
+        WP::Log::start();
+    }
+
+#ifndef NO_SECCOMP
+    install_syscall_filter();
+#endif
+
     WP::Map map;
-    WP::DeviceConfig in, out;
-    if (!parse_config(file, &map, &in, &out)) {
+    WP::Config config;
+    if (!config.load(file, &map)) {
         return 1;
     }
 
 
-    print_config(&map, &in, &out);
+    WP::DeviceConfig &out = config.output;
+    WP::TargetDevice target(out.name, out.vendor, out.product, out.version, out.axes, out.buttons);
+    map.compile(&target);
 
+#ifdef WP_COMPILED_MAP
+    if (g_wp_compiled_map.fingerprint == map.get_fingerprint()) {
+        target.set_compiled_map(&g_wp_compiled_map);
+        if (WP::Application::get_verbose()) {
+            printf("[Output] using the map compiled from \"%s\"\n", g_wp_compiled_map.config);
+        }
+    } else {
+        printf("config does not match the compiled map from \"%s\", falling back to the interpreter\n", g_wp_compiled_map.config);
+    }
+#endif
 
-    WP::SourceDevice src(in.name, in.vendor, in.product, in.version, in.axes, in.buttons);
-    WP::TargetDevice target(out.name, out.vendor, out.product, out.version, out.axes, out.buttons);
+    print_config(&map, &config);
+
+    target.set_table_limits(table_size, (size_t) table_budget * 1024);
+    WP::EventLoop loop(&target);
+    loop.set_spin_time((uint64_t) spin * 1000);
+
+    for (size_t i = 0, s = config.inputs.size(); i < s; ++i) {
+        WP::DeviceConfig *in = config.inputs[i];
+        WP::SourceDevice *src = new WP::SourceDevice(in->name, in->vendor, in->product, in->version, in->axes, in->buttons);
+        src->set_phys(in->phys);
+        src->set_uniq(in->uniq);
+        src->load_ranges();
+        loop.add_source(src);
+    }
 
-    if (!src.open()) return 1;
+    if (!loop.open()) return 1;
     if (!target.open()) return 1;
 
-    target.init(&src, &map);
+    target.init(&map);
+
+    if (realtime) {
+        WP::Realtime::enable(priority, cpu);
+    }
 
     printf("\n\nPress Ctrl+C to stop.\n");
-    while (!g_stop) {
-        if (!src.next_event()) {
-            // device lost, try to open again until SIGINT
-            printf("input device lost, trying to recover...\nPress Ctrl+C to stop.\n");
-            src.close();
-            usleep(1000000 * 2);
-            if (src.open()) {
-                target.init(&src, &map); // sync
-            }
-        }
+    const bool ok = loop.run(&g_stop);
+    WP::Log::stop();
+
+    if (!ok) {
+        return 1;
     }
 
     if (g_stop) {
         printf("received SIGINT, exiting...\n");
     }
 
+    if (WP::Application::get_verbose()) {
+        print_stats(&loop, &target);
+    }
+
     return 0;
 
 }
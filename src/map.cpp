@@ -18,6 +18,11 @@
 
 #include "map.h"
 #include "eventsource.h"
+#include "device.h"
+#include "axis.h"
+
+#include <assert.h>
+#include <map>
 
 
 namespace WP {
@@ -27,20 +32,14 @@ namespace WP {
 Map::Map()
 {
 
+    m_chord_button_count = 0;
+
 }
 
 
 Map::~Map()
 {
 
-    for (auto it = m_data.begin(), end = m_data.end(); it != end; ++it) {
-        auto vec = (*it).second;
-        for (size_t i = 0, s = vec->size(); i < s; ++i) {
-            delete (*vec)[i];
-        }
-        delete vec;
-    }
-
 }
 
 
@@ -48,23 +47,377 @@ void
 Map::add(WP::MapEntry *entry)
 {
 
-    auto vec = get_entries_for_src(entry->get_src());
-    if (vec == nullptr) {
-        vec = new std::vector<WP::MapEntry*>();
-        m_data.insert(std::make_pair(entry->get_src(), vec));
+    m_added.push_back(entry);
+
+}
+
+
+void
+Map::compile(const WP::Device *target)
+{
+
+    // pack all entries into one array, grouped by source in the order they were added,
+    // chord entries first so the target device sees them before the button's own ops
+    m_entries.clear();
+    m_entries.reserve(m_added.size());
+
+    for (size_t i = 0, s = m_added.size(); i < s; ++i) {
+        WP::EventSource *src = m_added[i]->get_src();
+        if (src->get_map_end() > src->get_map_begin()) continue; // done
+
+        const uint32_t begin = m_entries.size();
+        for (int chord = 1; chord >= 0; --chord) {
+            for (size_t j = i; j < s; ++j) {
+                if (m_added[j]->get_src() != src) continue;
+                if ((m_added[j]->get_op().code == WP::MapOp::BUTTON_TO_CHORD) != (chord == 1)) continue;
+                m_entries.push_back(*m_added[j]);
+            }
+        }
+        src->set_map_range(begin, m_entries.size());
+    }
+
+    m_added.clear();
+
+
+    // resolve the target slots and lay out the instruction stream in the same order
+    m_program.clear();
+    m_program.reserve(m_entries.size());
+    m_curves.clear();
+
+    std::vector<std::vector<uint32_t>> combine_inputs;
+    m_combines.clear();
+
+    std::map<const WP::EventSource*, uint16_t> chord_buttons;
+    std::vector<std::vector<uint16_t>> chord_members;
+    m_chords.clear();
+
+    m_macros.clear();
+    m_macro_steps.clear();
+
+    for (size_t i = 0, s = m_entries.size(); i < s; ++i) {
+        WP::MapEntry &entry = m_entries[i];
+        const uint16_t code = entry.get_target()->get_code();
+
+        if (entry.get_target()->get_type() == WP::EventSource::TYPE_AXIS) {
+            entry.set_slot(target->get_axis_index(code));
+        } else {
+            entry.set_slot(target->get_button_index(code));
+        }
+        assert(entry.get_op().slot != WP_NO_INDEX);
+
+        if (entry.get_op().code == WP::MapOp::AXIS_TO_COMBINE) {
+            // all entries of a group write the same target, the op refers to the combine instead
+            const uint16_t group = entry.get_combine_group();
+            if (group >= m_combines.size()) {
+                m_combines.resize(group + 1);
+                combine_inputs.resize(group + 1);
+            }
+
+            const WP::Axis *axis = (const WP::Axis*) entry.get_target();
+            WP::MapCombine &combine = m_combines[group];
+            combine.mode = entry.get_combine_mode();
+            combine.flags = entry.get_op().flags;
+            combine.slot = entry.get_op().slot;
+            combine.invert = axis->get_invert();
+            combine.target_min = axis->get_min();
+            combine.target_range = axis->get_max() > axis->get_min() ? (int64_t) axis->get_max() - axis->get_min() : 0;
+            combine_inputs[group].push_back(i);
+
+            entry.set_slot(group);
+        } else if (entry.get_op().code == WP::MapOp::BUTTON_TO_CHORD) {
+            // the op refers to the chord button, numbered over all source devices
+            const uint16_t group = entry.get_chord_group();
+            if (group >= m_chords.size()) {
+                m_chords.resize(group + 1);
+                chord_members.resize(group + 1);
+            }
+
+            WP::MapChord &chord = m_chords[group];
+            chord.flags = entry.get_op().flags;
+            chord.slot = entry.get_op().slot;
+            chord.window = entry.get_chord_window();
+
+            const auto it = chord_buttons.insert(std::make_pair(entry.get_src(), (uint16_t) chord_buttons.size())).first;
+            chord_members[group].push_back(it->second);
+
+            entry.set_slot(it->second);
+        } else if (entry.get_op().code == WP::MapOp::BUTTON_TO_MACRO) {
+            // the op refers to the macro, every entry has its own
+            WP::MapMacro macro;
+            macro.begin = m_macro_steps.size();
+
+            const std::vector<WP::Macro::Step> &steps = entry.get_macro()->get_steps();
+            for (size_t j = 0, c = steps.size(); j < c; ++j) {
+                const WP::Macro::Step &step = steps[j];
+
+                WP::MapMacroStep map_step;
+                map_step.type = step.type;
+                map_step.value = step.value;
+                map_step.delay = step.delay;
+
+                if (step.type == WP::Macro::Step::AXIS) {
+                    const WP::Axis *axis = (const WP::Axis*) step.target;
+                    map_step.slot = target->get_axis_index(axis->get_code());
+                    if (axis->get_invert()) {
+                        map_step.value = (int64_t) axis->get_min() + axis->get_max() - step.value;
+                    }
+                } else {
+                    map_step.slot = target->get_button_index(step.target->get_code());
+                }
+                assert(map_step.slot != WP_NO_INDEX);
+
+                m_macro_steps.push_back(map_step);
+            }
+
+            macro.end = m_macro_steps.size();
+            entry.set_slot(m_macros.size());
+            m_macros.push_back(macro);
+        }
+
+        entry.compile(&m_curves);
+
+        m_program.push_back(entry.get_op());
+    }
+
+
+    // inputs of each combine in program order, the first one is the minuend of a difference
+    m_combine_inputs.clear();
+    for (size_t i = 0, s = m_combines.size(); i < s; ++i) {
+        m_combines[i].begin = m_combine_inputs.size();
+        m_combine_inputs.insert(m_combine_inputs.end(), combine_inputs[i].begin(), combine_inputs[i].end());
+        m_combines[i].end = m_combine_inputs.size();
+    }
+
+
+    // one bit per chord button, get_chord_words() words per chord
+    m_chord_button_count = chord_buttons.size();
+    const size_t words = get_chord_words();
+    m_chord_masks.assign(m_chords.size() * words, 0);
+    for (size_t i = 0, s = m_chords.size(); i < s; ++i) {
+        for (size_t j = 0, c = chord_members[i].size(); j < c; ++j) {
+            const uint16_t button = chord_members[i][j];
+            m_chord_masks[i * words + button / 64] |= 1ULL << (button % 64);
+        }
     }
-    vec->push_back(entry);
 
 }
 
 
-std::vector<WP::MapEntry*> *
-Map::get_entries_for_src(WP::EventSource *src) const
+const WP::MapEntry *
+Map::get_entries(const WP::EventSource *src, size_t *count) const
+{
+
+    *count = src->get_map_end() - src->get_map_begin();
+    return m_entries.data() + src->get_map_begin();
+
+}
+
+
+const WP::MapOp *
+Map::get_program() const
+{
+
+    // ops of one source are at the [begin,end) range of its device slot
+    return m_program.data();
+
+}
+
+
+const int32_t *
+Map::get_curves() const
+{
+
+    return m_curves.data();
+
+}
+
+
+const WP::MapCombine *
+Map::get_combines() const
+{
+
+    return m_combines.data();
+
+}
+
+
+size_t
+Map::get_combine_count() const
+{
+
+    return m_combines.size();
+
+}
+
+
+const uint32_t *
+Map::get_combine_inputs() const
 {
 
-    const auto it = m_data.find(src);
-    if (it == m_data.end()) return nullptr;
-    return (*it).second;
+    return m_combine_inputs.data();
+
+}
+
+
+const WP::MapChord *
+Map::get_chords() const
+{
+
+    return m_chords.data();
+
+}
+
+
+size_t
+Map::get_chord_count() const
+{
+
+    return m_chords.size();
+
+}
+
+
+const uint64_t *
+Map::get_chord_masks() const
+{
+
+    return m_chord_masks.data();
+
+}
+
+
+size_t
+Map::get_chord_button_count() const
+{
+
+    return m_chord_button_count;
+
+}
+
+
+size_t
+Map::get_chord_words() const
+{
+
+    return (m_chord_button_count + 63) / 64;
+
+}
+
+
+const WP::MapMacro *
+Map::get_macros() const
+{
+
+    return m_macros.data();
+
+}
+
+
+size_t
+Map::get_macro_count() const
+{
+
+    return m_macros.size();
+
+}
+
+
+const WP::MapMacroStep *
+Map::get_macro_steps() const
+{
+
+    return m_macro_steps.data();
+
+}
+
+
+size_t
+Map::get_program_size() const
+{
+
+    return m_program.size();
+
+}
+
+
+WP::MapOp *
+Map::get_op_at(size_t i)
+{
+
+    return &m_program[i];
+
+}
+
+
+uint64_t
+Map::get_fingerprint() const
+{
+
+    // FNV-1a over everything a map compiled to C++ depends on
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto add = [&hash](int64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (uint8_t) (value >> (i * 8));
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    add(m_entries.size());
+    for (size_t i = 0, s = m_entries.size(); i < s; ++i) {
+        const WP::MapEntry &entry = m_entries[i];
+        const WP::MapOp &op = entry.get_op();
+
+        add(entry.get_src()->get_type());
+        add(entry.get_src()->get_device());
+        add(entry.get_src()->get_code());
+        add(entry.get_src()->get_map_begin() == i);
+        add(op.code);
+        add(op.flags);
+        add(op.slot);
+
+        switch (op.code) {
+        case WP::MapOp::AXIS_TO_AXIS:
+        case WP::MapOp::AXIS_TO_COMBINE:
+            add(op.operands.scale.src_min);
+            add(op.operands.scale.src_range);
+            add(op.operands.scale.target_min);
+            add(op.operands.scale.shift);
+            add(op.operands.scale.invert);
+            add(op.operands.scale.mul[0]);
+            add(op.operands.scale.mul[1]);
+            break;
+        case WP::MapOp::AXIS_TO_AXIS_CURVE:
+            add(op.operands.curve.src_min);
+            add(op.operands.curve.src_range);
+            add(op.operands.curve.step);
+            for (int k = 0; k <= WP_CURVE_SEGMENTS; ++k) {
+                add(m_curves[op.operands.curve.offset + k]);
+            }
+            break;
+        default:
+            add(op.operands.values[0]);
+            add(op.operands.values[1]);
+            break;
+        }
+    }
+
+    add(m_combines.size());
+    for (size_t i = 0, s = m_combines.size(); i < s; ++i) {
+        const WP::MapCombine &combine = m_combines[i];
+        add(combine.mode);
+        add(combine.flags);
+        add(combine.slot);
+        add(combine.invert);
+        add(combine.target_min);
+        add(combine.target_range);
+        for (uint32_t j = combine.begin; j < combine.end; ++j) {
+            add(m_combine_inputs[j]);
+        }
+    }
+
+    // chords and macros are run by the target device from the map, a compiled map only
+    // depends on where their ops are, which the entries cover
+    return hash;
 
 }
 
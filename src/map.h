@@ -23,8 +23,8 @@
 #include "mapentry.h"
 
 
+#include <stddef.h>
 #include <stdint.h>
-#include <map>
 #include <vector>
 
 
@@ -34,6 +34,7 @@ namespace WP {
 class EventSource;
 class Axis;
 class Button;
+class Device;
 class Map
 {
 
@@ -43,11 +44,41 @@ public:
     ~Map();
 
     void add(WP::MapEntry *entry);
-    std::vector<WP::MapEntry*> *get_entries_for_src(WP::EventSource *src) const;
+    void compile(const WP::Device *target);
+
+    const WP::MapEntry *get_entries(const WP::EventSource *src, size_t *count) const;
+    const WP::MapOp *get_program() const;
+    const int32_t *get_curves() const;
+    const WP::MapCombine *get_combines() const;
+    size_t get_combine_count() const;
+    const uint32_t *get_combine_inputs() const;
+    const WP::MapChord *get_chords() const;
+    size_t get_chord_count() const;
+    const uint64_t *get_chord_masks() const;
+    size_t get_chord_button_count() const;
+    size_t get_chord_words() const;
+    const WP::MapMacro *get_macros() const;
+    size_t get_macro_count() const;
+    const WP::MapMacroStep *get_macro_steps() const;
+
+    size_t get_program_size() const;
+    WP::MapOp *get_op_at(size_t i);
+
+    uint64_t get_fingerprint() const;
 
 
 private:
-    std::map<WP::EventSource*, std::vector<WP::MapEntry*>*> m_data;
+    std::vector<WP::MapEntry*> m_added; // owned by the config arena, until compile()
+    std::vector<WP::MapEntry> m_entries;
+    std::vector<WP::MapOp> m_program;
+    std::vector<int32_t> m_curves; // knots of all curve ops
+    std::vector<WP::MapCombine> m_combines; // indexed by the combine group
+    std::vector<uint32_t> m_combine_inputs;
+    std::vector<WP::MapChord> m_chords; // indexed by the chord group
+    std::vector<uint64_t> m_chord_masks; // chord buttons of each chord
+    size_t m_chord_button_count;
+    std::vector<WP::MapMacro> m_macros; // indexed by the op slot of BUTTON_TO_MACRO
+    std::vector<WP::MapMacroStep> m_macro_steps;
 
 
 };
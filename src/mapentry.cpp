@@ -18,147 +18,382 @@
 
 
 #include "mapentry.h"
+#include "eventsource.h"
+#include "axis.h"
+#include "curve.h"
 
 
 #include <assert.h>
+#include <cstring>
 
 
 
-namespace WP {
+static int32_t
+mirror_value(int64_t value, int64_t min, int64_t max)
+{
+
+    value = min + max - value;
+    if (value < INT32_MIN) return INT32_MIN;
+    if (value > INT32_MAX) return INT32_MAX;
+    return value;
+
+}
+
 
+// raw source values that cover the target, invert if max maps to the target min
+struct wp_src_span {
+    int32_t min;
+    int32_t max;
+    bool invert;
+};
 
-MapEntry::Data::Data()
+
+static wp_src_span
+get_src_span(const WP::Axis *src, bool split, const int32_t *range)
 {
 
+    wp_src_span span = { src->get_min(), src->get_max(), src->get_invert() };
+    if (!split) return span;
+
+    // the split range is given like an axis to button range, in values after invert
+    int32_t start = range[0];
+    int32_t end = range[1];
+    if (src->get_invert()) {
+        start = mirror_value(start, src->get_min(), src->get_max());
+        end = mirror_value(end, src->get_min(), src->get_max());
+    }
+
+    span.min = start < end ? start : end;
+    span.max = start < end ? end : start;
+    span.invert = start > end;
+    return span;
 
 }
 
 
-MapEntry::Data::~Data()
+static void
+init_axis_scale(WP::AxisScale *scale, const wp_src_span &src, int32_t target_min, int32_t target_max, bool target_invert)
 {
 
+    const int64_t src_range = (int64_t) src.max - src.min;
+    const int64_t target_range = (int64_t) target_max - target_min;
+
+    memset(scale, 0, sizeof(*scale));
+    scale->src_min = src.min;
+    scale->target_min = target_min;
+    scale->invert = src.invert != target_invert;
+
+    if (src_range <= 0 || target_range <= 0) return; // constant target_min
+
+    scale->src_range = src_range;
+
+    // with src_range < 2^b and 2b + 1 fraction bits the error of the rounded up multiplier
+    // stays below 1 / (2 * src_range), the smallest distance of an exact quotient to
+    // a rounding boundary, so the result is the exactly rounded quotient for every input
+    int b = 0;
+    while ((src_range >> b) != 0) ++b;
+    const int fraction_bits = 2 * b + 1;
+    scale->shift = fraction_bits - 1;
+
+    const unsigned __int128 mul = (((unsigned __int128) target_range << fraction_bits) + src_range - 1) / src_range;
+    scale->mul[0] = (uint64_t) mul;
+    scale->mul[1] = (uint64_t) (mul >> 64);
 
 }
 
+static void
+init_axis_curve(WP::AxisCurve *curve, const wp_src_span &src)
+{
+
+    const int64_t src_range = (int64_t) src.max - src.min;
+
+    curve->src_min = src.min;
+    curve->src_range = src_range > 0 ? src_range : 0;
+
+    // rounded up, so the last source value reaches the last knot
+    const uint64_t scale = (uint64_t) WP_CURVE_SEGMENTS << 48;
+    curve->step = src_range > 0 ? (scale + src_range - 1) / src_range : 0;
+
+}
+
+
+
+namespace WP {
+
+
+
+MapEntry::MapEntry(WP::EventSource *src, WP::EventSource *target)
+{
+
+    m_src = src;
+    m_target = target;
+    m_curve = nullptr;
+    m_macro = nullptr;
+    m_split = false;
+    m_split_range[0] = 0;
+    m_split_range[1] = 0;
+    m_combine_mode = 0;
+    m_combine_group = 0;
+    m_chord_group = 0;
+    m_chord_window = 0;
+
+    assert(src != nullptr);
+    assert(target != nullptr);
+
+    memset(&m_op, 0, sizeof(m_op));
+    if (src->get_type() == WP::EventSource::TYPE_AXIS) {
+        m_op.code = target->get_type() == WP::EventSource::TYPE_AXIS ? WP::MapOp::AXIS_TO_AXIS : WP::MapOp::AXIS_TO_BUTTON;
+    } else {
+        m_op.code = target->get_type() == WP::EventSource::TYPE_AXIS ? WP::MapOp::BUTTON_TO_AXIS : WP::MapOp::BUTTON_TO_BUTTON;
+    }
+
+}
+
+
+MapEntry::~MapEntry()
+{
+
+}
+
+
+
+const WP::MapOp &
+MapEntry::get_op() const
+{
+
+    return m_op;
+
+}
 
 
-AxisToButtonData::AxisToButtonData(int32_t start, int32_t end)
-    : MapEntry::Data()
+WP::EventSource *
+MapEntry::get_src() const
 {
 
-    m_range[0] = start;
-    m_range[1] = end;
+    return m_src;
+
+}
+
 
-    assert(end >= start);
+WP::EventSource *
+MapEntry::get_target() const
+{
+
+    return m_target;
 
 }
 
 
-AxisToButtonData::~AxisToButtonData()
+const WP::Curve *
+MapEntry::get_curve() const
 {
 
+    return m_curve;
 
 }
 
 
+const WP::Macro *
+MapEntry::get_macro() const
+{
+
+    return m_macro;
+
+}
+
 
-int32_t
-AxisToButtonData::get_range_start() const
+uint8_t
+MapEntry::get_combine_mode() const
 {
 
-    return m_range[0];
+    return m_combine_mode;
 
 }
 
 
-int32_t
-AxisToButtonData::get_range_end() const
+uint16_t
+MapEntry::get_combine_group() const
 {
 
-    return m_range[1];
+    return m_combine_group;
 
 }
 
 
+uint16_t
+MapEntry::get_chord_group() const
+{
 
-ButtonToAxisData::ButtonToAxisData(int32_t value_released, int32_t value_pressed)
-    : MapEntry::Data()
+    return m_chord_group;
+
+}
+
+
+uint32_t
+MapEntry::get_chord_window() const
 {
 
-    m_values[0] = value_released;
-    m_values[1] = value_pressed;
+    return m_chord_window;
 
 }
 
 
-ButtonToAxisData::~ButtonToAxisData()
+void
+MapEntry::set_range(int32_t start, int32_t end)
 {
 
+    assert(m_op.code == WP::MapOp::AXIS_TO_BUTTON);
+
+    m_op.operands.range[0] = start;
+    m_op.operands.range[1] = end;
 
 }
 
 
-int32_t
-ButtonToAxisData::get_value_released() const
+void
+MapEntry::set_values(int32_t released, int32_t pressed)
 {
 
-    return m_values[0];
+    assert(m_op.code == WP::MapOp::BUTTON_TO_AXIS);
+
+    m_op.operands.values[0] = released;
+    m_op.operands.values[1] = pressed;
 
 }
 
 
-int32_t
-ButtonToAxisData::get_value_pressed() const
+void
+MapEntry::set_slot(uint16_t slot)
 {
 
-    return m_values[1];
+    m_op.slot = slot;
 
 }
 
 
+void
+MapEntry::set_heartbeat(bool heartbeat)
+{
+
+    if (heartbeat) {
+        m_op.flags |= WP::MapOp::FLAG_HEARTBEAT;
+    } else {
+        m_op.flags &= ~WP::MapOp::FLAG_HEARTBEAT;
+    }
+
+}
+
 
-MapEntry::MapEntry(WP::EventSource *src, WP::EventSource *target, WP::MapEntry::Data *data)
+void
+MapEntry::set_split(int32_t start, int32_t end)
 {
 
-    m_data = data;
-    m_src = src;
-    m_target = target;
+    assert(m_src->get_type() == WP::EventSource::TYPE_AXIS && m_target->get_type() == WP::EventSource::TYPE_AXIS);
 
-    assert(src != nullptr);
-    assert(target != nullptr);
+    m_split = true;
+    m_split_range[0] = start;
+    m_split_range[1] = end;
 
 }
 
 
-MapEntry::~MapEntry()
+void
+MapEntry::set_curve(const WP::Curve *curve)
 {
 
-    delete m_data;
+    assert(m_op.code == WP::MapOp::AXIS_TO_AXIS || m_op.code == WP::MapOp::AXIS_TO_AXIS_CURVE);
+
+    m_curve = curve;
+    m_op.code = curve != nullptr ? WP::MapOp::AXIS_TO_AXIS_CURVE : WP::MapOp::AXIS_TO_AXIS;
 
 }
 
 
+void
+MapEntry::set_combine(uint8_t mode, uint16_t group)
+{
+
+    assert(m_op.code == WP::MapOp::AXIS_TO_AXIS);
+
+    m_op.code = WP::MapOp::AXIS_TO_COMBINE;
+    m_combine_mode = mode;
+    m_combine_group = group;
+
+}
 
-WP::MapEntry::Data *MapEntry::get_data() const
+
+void
+MapEntry::set_chord(uint16_t group, uint32_t window)
 {
 
-    return m_data;
+    assert(m_op.code == WP::MapOp::BUTTON_TO_BUTTON);
+
+    m_op.code = WP::MapOp::BUTTON_TO_CHORD;
+    m_chord_group = group;
+    m_chord_window = window;
 
 }
 
 
-WP::EventSource *MapEntry::get_src() const
+void
+MapEntry::set_macro(const WP::Macro *macro)
 {
 
-    return m_src;
+    assert(m_src->get_type() == WP::EventSource::TYPE_BUTTON && macro != nullptr);
+
+    m_op.code = WP::MapOp::BUTTON_TO_MACRO;
+    m_macro = macro;
 
 }
 
 
-WP::EventSource *MapEntry::get_target() const
+void
+MapEntry::compile(std::vector<int32_t> *knots)
 {
 
-    return m_target;
+    // fold the axis config into the operands, the target device only deals with raw values
+    switch (m_op.code) {
+    case WP::MapOp::AXIS_TO_AXIS: {
+        const WP::Axis *target = (const WP::Axis*) m_target;
+        const wp_src_span span = get_src_span((const WP::Axis*) m_src, m_split, m_split_range);
+        init_axis_scale(&m_op.operands.scale, span, target->get_min(), target->get_max(), target->get_invert());
+        break;
+    }
+    case WP::MapOp::AXIS_TO_AXIS_CURVE: {
+        // invert of both axes is part of the knots
+        const wp_src_span span = get_src_span((const WP::Axis*) m_src, m_split, m_split_range);
+        init_axis_curve(&m_op.operands.curve, span);
+        m_op.operands.curve.offset = knots->size();
+        knots->resize(knots->size() + WP_CURVE_SEGMENTS + 1);
+        m_curve->sample(span.invert, (const WP::Axis*) m_target, knots->data() + m_op.operands.curve.offset);
+        break;
+    }
+    case WP::MapOp::AXIS_TO_COMBINE: {
+        // inputs are normalized, the combine scales the result to the target
+        const wp_src_span span = get_src_span((const WP::Axis*) m_src, m_split, m_split_range);
+        init_axis_scale(&m_op.operands.scale, span, 0, WP_COMBINE_ONE, false);
+        break;
+    }
+    case WP::MapOp::AXIS_TO_BUTTON: {
+        const WP::Axis *axis = (const WP::Axis*) m_src;
+        if (axis->get_invert()) {
+            const int32_t start = mirror_value(m_op.operands.range[1], axis->get_min(), axis->get_max());
+            const int32_t end = mirror_value(m_op.operands.range[0], axis->get_min(), axis->get_max());
+            m_op.operands.range[0] = start;
+            m_op.operands.range[1] = end;
+        }
+        break;
+    }
+    case WP::MapOp::BUTTON_TO_AXIS: {
+        const WP::Axis *axis = (const WP::Axis*) m_target;
+        if (axis->get_invert()) {
+            m_op.operands.values[0] = mirror_value(m_op.operands.values[0], axis->get_min(), axis->get_max());
+            m_op.operands.values[1] = mirror_value(m_op.operands.values[1], axis->get_min(), axis->get_max());
+        }
+        break;
+    }
+    default: break;
+    }
 
 }
 
@@ -21,7 +21,17 @@
 #define MAPENTRY_H
 
 
+#include "curve.h"
+#include "macro.h"
+
 #include <stdint.h>
+#include <vector>
+
+
+#define WP_COMBINE_ONE        65536 // full travel of one combine input
+#define WP_COMBINE_MAX_INPUTS 8
+#define WP_CHORD_MAX_BUTTONS  8
+#define WP_CHORD_WINDOW_MS    50 // default time the buttons of a chord wait for each other
 
 
 namespace WP {
@@ -29,68 +39,264 @@ namespace WP {
 
 
 class EventSource;
-class MapEntry
+
+
+// integer axis to axis conversion, derived once from the min/max/invert of both axes:
+// value = target_min + round((clamp(value) - src_min) * target_range / src_range)
+struct AxisScale
 {
 
+    int32_t src_min;
+    uint32_t src_range;
+    int32_t target_min;
+    uint8_t shift; // one less than the fraction bits, the last bit rounds
+    bool invert;
+    uint64_t mul[2]; // low, high
 
-public:
-    class Data {
-    public:
-        Data();
-        virtual ~Data();
+};
+
+
+// dense source value -> target value table, built by the target device for small source ranges
+struct AxisTable
+{
+
+    int32_t src_min;
+    uint32_t size;
+    uint32_t offset;
+
+};
+
+
+// response curve sampled at WP_CURVE_SEGMENTS + 1 evenly spaced source positions,
+// values in between are interpolated linearly
+struct AxisCurve
+{
+
+    int32_t src_min;
+    uint32_t src_range;
+    uint32_t offset; // of the first knot
+    uint64_t step;   // WP_CURVE_SEGMENTS * 2^48 / src_range: source position -> segment in 16.16 fixed point
+
+};
+
+
+// kept inline, shared by the target device and maps compiled to C++ by wp-compile
+inline int32_t
+scale_axis_value(const WP::AxisScale &scale, int32_t value)
+{
+
+    int64_t x = (int64_t) value - scale.src_min;
+    if (x < 0) x = 0;
+    else if (x > scale.src_range) x = scale.src_range;
+    if (scale.invert) x = scale.src_range - x;
+
+    // x < 2^32 and x * mul < 2^98, so the high product fits in 64 bits
+    const uint64_t ux = x;
+    const unsigned __int128 product = (unsigned __int128) ux * scale.mul[0] + ((unsigned __int128) (ux * scale.mul[1]) << 64);
+    return scale.target_min + (int64_t) (((uint64_t) (product >> scale.shift) + 1) >> 1);
+
+}
+
+
+inline int32_t
+lookup_axis_value(const WP::AxisTable &table, const int32_t *tables, int32_t value)
+{
+
+    int64_t x = (int64_t) value - table.src_min;
+    if (x < 0) x = 0;
+    else if (x >= table.size) x = table.size - 1;
+
+    return tables[table.offset + x];
+
+}
+
+
+inline int32_t
+curve_axis_value(const WP::AxisCurve &curve, const int32_t *knots, int32_t value)
+{
+
+    int64_t x = (int64_t) value - curve.src_min;
+    if (x < 0) x = 0;
+    else if (x > curve.src_range) x = curve.src_range;
+
+    const uint64_t position = (uint64_t) (((unsigned __int128) (uint64_t) x * curve.step) >> 32);
+    uint32_t segment = position >> 16;
+    int64_t fraction = position & 0xffff;
+    if (segment >= WP_CURVE_SEGMENTS) {
+        segment = WP_CURVE_SEGMENTS - 1;
+        fraction = 0x10000;
+    }
+
+    const int32_t *knot = knots + curve.offset + segment;
+    return knot[0] + (int32_t) ((((int64_t) knot[1] - knot[0]) * fraction + 0x8000) >> 16);
+
+}
+
+
+// one compiled mapping instruction, executed by the target device
+struct MapOp
+{
+
+    enum Code : uint8_t {
+        AXIS_TO_AXIS,
+        AXIS_TO_AXIS_TABLE,
+        AXIS_TO_AXIS_CURVE,
+        AXIS_TO_COMBINE,
+        AXIS_TO_BUTTON,
+        BUTTON_TO_BUTTON,
+        BUTTON_TO_AXIS,
+        BUTTON_TO_CHORD,
+        BUTTON_TO_MACRO
     };
 
+    enum Flags : uint8_t {
+        FLAG_HEARTBEAT = 1 << 0 // emit unchanged target values too
+    };
 
-    MapEntry(WP::EventSource *src, WP::EventSource *target, WP::MapEntry::Data *data);
-    ~MapEntry();
+    uint8_t code;
+    uint8_t flags;
+    uint16_t slot; // index of the target axis or button, of the combine for AXIS_TO_COMBINE,
+                   // of the chord button for BUTTON_TO_CHORD, of the macro for BUTTON_TO_MACRO
+    union {
+        int32_t range[2];  // axis to button: start, end
+        int32_t values[2]; // button to axis: released, pressed
+        WP::AxisScale scale; // axis to axis, axis to combine (0..WP_COMBINE_ONE)
+        WP::AxisTable table; // axis to axis table
+        WP::AxisCurve curve; // axis to axis curve
+    } operands;
 
+};
 
-    WP::MapEntry::Data *get_data() const;
-    WP::EventSource *get_src() const;
-    WP::EventSource *get_target() const;
 
+// several source axes folded into one target axis, evaluated once per frame
+// from the last values of its input ops
+struct MapCombine
+{
 
-private:
-    WP::MapEntry::Data *m_data;
-    WP::EventSource *m_src;
-    WP::EventSource *m_target;
+    enum Mode : uint8_t {
+        SUM,        // of all inputs, clamped to the target range
+        DIFFERENCE, // first input minus the others, no input is the center
+        MAX         // largest input
+    };
 
+    uint8_t mode;
+    uint8_t flags; // MapOp flags of the output
+    uint16_t slot; // target axis
+    bool invert;
+    int32_t target_min;
+    uint32_t target_range;
+    uint32_t begin; // [begin,end) of the combine inputs, program indices of the AXIS_TO_COMBINE ops
+    uint32_t end;
 
 };
 
 
-class AxisToButtonData : public MapEntry::Data
+// kept inline, shared by the target device and maps compiled to C++ by wp-compile
+inline int32_t
+combine_axis_value(const WP::MapCombine &combine, const int32_t *values, const uint32_t *inputs)
+{
+
+    int64_t x = 0;
+    switch (combine.mode) {
+    case WP::MapCombine::SUM:
+        for (uint32_t i = combine.begin; i < combine.end; ++i) x += values[inputs[i]];
+        if (x > WP_COMBINE_ONE) x = WP_COMBINE_ONE;
+        break;
+    case WP::MapCombine::DIFFERENCE:
+        x = values[inputs[combine.begin]];
+        for (uint32_t i = combine.begin + 1; i < combine.end; ++i) x -= values[inputs[i]];
+        if (x < -WP_COMBINE_ONE) x = -WP_COMBINE_ONE;
+        x = (x + WP_COMBINE_ONE) >> 1;
+        break;
+    case WP::MapCombine::MAX:
+        for (uint32_t i = combine.begin; i < combine.end; ++i) {
+            if (values[inputs[i]] > x) x = values[inputs[i]];
+        }
+        break;
+    default: break;
+    }
+
+    if (combine.invert) x = WP_COMBINE_ONE - x;
+    return combine.target_min + (int32_t) ((x * combine.target_range + WP_COMBINE_ONE / 2) >> 16);
+
+}
+
+
+// buttons that press one target button together, instead of their own mappings
+struct MapChord
 {
 
+    uint8_t flags;   // MapOp flags of the output
+    uint16_t slot;   // target button
+    uint32_t window; // ms a pressed button waits for the rest of the chord
 
-public:
-    AxisToButtonData(int32_t start, int32_t end);
-    ~AxisToButtonData();
+};
 
-    int32_t get_range_start() const;
-    int32_t get_range_end() const;
 
+// macro step with the target slot resolved, played by the target device
+struct MapMacroStep
+{
 
-private:
-    int32_t m_range[2];
+    uint8_t type;   // Macro::Step::Type
+    uint16_t slot;  // target button or axis
+    int32_t value;  // raw axis value
+    uint32_t delay; // ms after the previous step
+
+};
+
+
+struct MapMacro
+{
 
+    uint32_t begin; // [begin,end) of the macro steps
+    uint32_t end;
 
 };
 
 
-class ButtonToAxisData : public MapEntry::Data {
+class MapEntry
+{
 
 
 public:
-    ButtonToAxisData(int32_t value_released, int32_t value_pressed);
-    ~ButtonToAxisData();
+    MapEntry(WP::EventSource *src, WP::EventSource *target);
+    ~MapEntry();
 
-    int32_t get_value_released() const;
-    int32_t get_value_pressed() const;
+
+    const WP::MapOp &get_op() const;
+    WP::EventSource *get_src() const;
+    WP::EventSource *get_target() const;
+    const WP::Curve *get_curve() const;
+    const WP::Macro *get_macro() const;
+    uint8_t get_combine_mode() const;
+    uint16_t get_combine_group() const;
+    uint16_t get_chord_group() const;
+    uint32_t get_chord_window() const;
+
+    void set_range(int32_t start, int32_t end);
+    void set_values(int32_t released, int32_t pressed);
+    void set_slot(uint16_t slot);
+    void set_heartbeat(bool heartbeat);
+    void set_split(int32_t start, int32_t end);
+    void set_curve(const WP::Curve *curve);
+    void set_combine(uint8_t mode, uint16_t group);
+    void set_chord(uint16_t group, uint32_t window);
+    void set_macro(const WP::Macro *macro);
+    void compile(std::vector<int32_t> *knots);
 
 
 private:
-    int32_t m_values[2];
+    WP::MapOp m_op;
+    WP::EventSource *m_src;
+    WP::EventSource *m_target;
+    const WP::Curve *m_curve; // owned by the config arena
+    const WP::Macro *m_macro; // owned by the config arena
+    bool m_split;
+    int32_t m_split_range[2]; // source values mapped to the target min and max
+    uint8_t m_combine_mode;
+    uint16_t m_combine_group; // entries of one combine share the group
+    uint16_t m_chord_group;
+    uint32_t m_chord_window;
 
 
 };
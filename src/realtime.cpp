@@ -0,0 +1,109 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "realtime.h"
+#include "application.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+
+static void __attribute__((noinline))
+prefault_stack()
+{
+
+    // touch the stack once so the event loop never takes a page fault on it
+    volatile char stack[WP_REALTIME_PREFAULT_SIZE];
+    memset((char*) stack, 0, sizeof(stack));
+
+}
+
+
+
+namespace WP {
+
+
+
+bool
+Realtime::enable(int priority, int cpu)
+{
+
+    bool ret = true;
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            printf("realtime: failed to pin to cpu %d: %s\n", cpu, strerror(errno));
+            ret = false;
+        } else if (WP::Application::get_verbose()) {
+            printf("[Realtime] pinned to cpu %d\n", cpu);
+        }
+    }
+
+
+    const int min = sched_get_priority_min(SCHED_FIFO);
+    const int max = sched_get_priority_max(SCHED_FIFO);
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    // a bad priority only costs the scheduling, memory is still locked below
+    if (priority < min || priority > max) {
+        printf("realtime: priority %d out of range %d..%d, keeping normal priority\n", priority, min, max);
+        ret = false;
+    } else if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+        if (errno == EPERM) {
+            printf("realtime: SCHED_FIFO not permitted (needs CAP_SYS_NICE or RLIMIT_RTPRIO), keeping normal priority\n");
+        } else {
+            printf("realtime: sched_setscheduler: %s\n", strerror(errno));
+        }
+        ret = false;
+    } else if (WP::Application::get_verbose()) {
+        printf("[Realtime] SCHED_FIFO priority %d\n", priority);
+    }
+
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        if (errno == EPERM || errno == ENOMEM) {
+            printf("realtime: memory not locked (needs CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK), page faults may add latency\n");
+        } else {
+            printf("realtime: mlockall: %s\n", strerror(errno));
+        }
+        ret = false;
+    } else {
+        prefault_stack();
+
+        if (WP::Application::get_verbose()) {
+            printf("[Realtime] memory locked\n");
+        }
+    }
+
+    return ret;
+
+}
+
+
+
+} // namespace WP
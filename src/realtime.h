@@ -0,0 +1,48 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+
+#define WP_REALTIME_PRIORITY      50
+#define WP_REALTIME_PREFAULT_SIZE (256 * 1024)
+
+
+
+namespace WP {
+
+
+
+class Realtime
+{
+
+
+public:
+    static bool enable(int priority, int cpu);
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // REALTIME_H
@@ -20,6 +20,9 @@
 #include "axis.h"
 #include "button.h"
 #include "application.h"
+#include "log.h"
+#include "discovery.h"
+#include "utils.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -35,70 +38,25 @@
 #include <signal.h>
 #include <algorithm>
 #include <string>
-#include <fstream>
-#include <streambuf>
-#include <sstream>
-#include <iterator>
-#include <algorithm>
-#include <regex>
-#include <poll.h>
-
 
-static bool
-is_button_pressed(int fd, int key)
-{
-
-    char key_b[KEY_MAX/8 + 1];
-    memset(key_b, 0, sizeof(key_b));
-    ioctl(fd, EVIOCGKEY(sizeof(key_b)), key_b);
-    return !!(key_b[key/8] & (1<<(key % 8)));
-
-}
 
+#define BITS_PER_LONG (sizeof(long) * 8)
 
 
-static void
-device_src_parse_i(const std::string &line, uint16_t *vendor, uint16_t *product, uint16_t *version)
+static bool
+test_bit(const unsigned long *bits, int bit)
 {
 
-    *vendor = 0;
-    *product = 0;
-    *version = 0;
-
-
-    static const std::regex regex("^I: Bus=([0-9a-zA-Z]+)\\sVendor=([0-9a-zA-Z]+)\\sProduct=([0-9a-zA-Z]+)\\sVersion=([0-9a-zA-Z]+)$");
-    std::smatch m;
-    if (!std::regex_match(line, m, regex) || m.size() != 5) {
-        return;
-    }
-
-    std::stringstream ss;
-
-    ss << std::hex << m[2];
-    ss >> *vendor;
-
-    ss.clear();
-    ss << std::hex << m[3];
-    ss >> *product;
-
-    ss.clear();
-    ss << std::hex << m[4];
-    ss >> *version;
+    return !!(bits[bit / BITS_PER_LONG] & (1UL << (bit % BITS_PER_LONG)));
 
 }
 
 
 static void
-device_src_parse_h(const std::string &line, std::string *handler)
+set_bit(unsigned long *bits, int bit)
 {
 
-    static const std::regex regex("(event[0-9]+)");
-    std::smatch m;
-    if (!std::regex_search(line, m, regex)) {
-        return;
-    }
-
-    *handler = m[0];
+    bits[bit / BITS_PER_LONG] |= 1UL << (bit % BITS_PER_LONG);
 
 }
 
@@ -113,6 +71,24 @@ SourceDevice::SourceDevice(const std::string &name, uint16_t vendor, uint16_t pr
     : WP::Device(name, vendor, product, version, axes, buttons)
 {
 
+    m_fd = -1;
+    m_event_count = 0;
+    m_dropped = false;
+    m_monotonic = false;
+    m_masked = false;
+    m_opened = false;
+    m_timers = nullptr;
+    m_settle_time = 0;
+    memset(m_key_mask, 0xff, sizeof(m_key_mask));
+    memset(m_abs_mask, 0xff, sizeof(m_abs_mask));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    m_axis_filters.resize(get_axis_count());
+    m_filter_states.resize(get_axis_count()); // zeroed, primed by the first value
+    for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
+        m_axis_filters[i] = get_axis_at(i)->get_filter();
+    }
+
 }
 
 
@@ -128,63 +104,51 @@ bool
 SourceDevice::open()
 {
 
-    const std::string handler = get_handler();
-    if (handler.size() < 1) {
-        printf("input device not found: name=\"%s\" vendor=\"%04x\" product=\"%04x\" version=\"%04x\"\n",
-               get_name().c_str(), get_vendor(), get_product(), get_version());
+    WP::Discovery::DeviceInfo info;
+    if (!WP::Discovery::find(get_vendor(), get_product(), get_version(), m_phys, m_uniq, &info)) {
+        printf("input device not found: name=\"%s\" vendor=\"%04x\" product=\"%04x\" version=\"%04x\" phys=\"%s\" uniq=\"%s\"\n",
+               get_name().c_str(), get_vendor(), get_product(), get_version(), m_phys.c_str(), m_uniq.c_str());
         printf("please connect the device and try again\n");
         return false;
     }
 
-    const std::string path = "/dev/input/" + handler;
+    m_handler = info.handler;
+    const std::string path = "/dev/input/" + m_handler;
 
     errno = 0;
-    m_fd = ::open(path.c_str(), O_RDONLY/*O_RDWR*/);
+    m_fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
     if (m_fd < 0) {
         m_fd = -1;
         perror("failed to open input device");
         return false;
     }
 
-    m_fds[0].fd = m_fd;
-    m_fds[0].events = POLLIN;
-
-
-    if (WP::Application::get_verbose()) {
-        printf("[Input] get initial state...\n");
-    }
+    // skipped by the other sources from now on
+    WP::Discovery::claim(m_handler);
 
-    unsigned long keys[KEY_MAX/8 + 1];
-    memset(keys, 0, sizeof(keys));
-    if (ioctl(m_fd, EVIOCGKEY(sizeof(keys)), &keys) < 0) {
-        perror("ioctl EVIOCGBIT");
-    } else {
-        for (size_t i = 0, c = get_button_count(); i < c; ++i) {
-            WP::Button *button = get_button_at(i);
+    m_event_count = 0;
+    m_dropped = false;
 
-            button->set_down(is_button_pressed(m_fd, button->get_code()));
 
-            if (WP::Application::get_verbose()) {
-                printf("[Input] button=\"%s\" state=\"%s\"\n", button->get_name().c_str(), button->get_down() ? "pressed" : "released");
-            }
-        }
+    // timestamps on the same clock as Utils::get_time()
+    const int clock = CLOCK_MONOTONIC;
+    m_monotonic = ioctl(m_fd, EVIOCSCLOCKID, &clock) == 0;
+    if (!m_monotonic && WP::Application::get_verbose()) {
+        perror("[Input] ioctl EVIOCSCLOCKID");
     }
 
+    install_event_mask();
 
-    for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
-        WP::Axis *axis = get_axis_at(i);
 
-        struct input_absinfo abs;
-        if (ioctl(m_fd, EVIOCGABS(axis->get_code()), &abs) < 0) {
-            perror("ioctl EVIOCGABS");
-            continue;
-        }
-        axis->set_value(abs.value);
-        if (WP::Application::get_verbose()) {
-            printf("[Input] axis=\"%s\" position=\"%d\"\n", axis->get_name().c_str(), axis->get_value());
-        }
+    if (WP::Application::get_verbose()) {
+        printf("[Input] get initial state...\n");
     }
 
+    // after a reconnect the mapping has to see what changed while the device was gone,
+    // a button released in the meantime would stay pressed otherwise
+    sync_state(m_opened);
+    m_opened = true;
+
     if (WP::Application::get_verbose()) {
         printf("[Input] done\n");
     }
@@ -194,6 +158,20 @@ SourceDevice::open()
 }
 
 
+void
+SourceDevice::open_replay(int fd)
+{
+
+    close();
+
+    m_fd = fd;
+    m_event_count = 0;
+    m_dropped = false;
+    m_monotonic = true;
+
+}
+
+
 void
 SourceDevice::close()
 {
@@ -203,133 +181,412 @@ SourceDevice::close()
         m_fd = -1;
     }
 
+    if (m_settle_time != 0) {
+        m_timers->set_timer(this, 0);
+        m_settle_time = 0;
+    }
+
+    // the node may be reused by another device
+    if (m_handler.size() > 0) {
+        WP::Discovery::release(m_handler);
+        WP::Discovery::invalidate(m_handler);
+        m_handler.clear();
+    }
+
+}
+
+
+void
+SourceDevice::set_phys(const std::string &phys)
+{
+
+    m_phys = phys;
+
+}
+
+
+void
+SourceDevice::set_uniq(const std::string &uniq)
+{
+
+    m_uniq = uniq;
+
+}
+
+
+void
+SourceDevice::load_ranges()
+{
+
+    load_map_ranges();
+
+    // only codes which are mapped to something are of interest
+    memset(m_key_mask, 0, sizeof(m_key_mask));
+    memset(m_abs_mask, 0, sizeof(m_abs_mask));
+
+    for (size_t i = 0, c = get_button_count(); i < c; ++i) {
+        const WP::Device::Range &range = get_button_range(i);
+        if (range.end > range.begin) {
+            set_bit(m_key_mask, get_button_at(i)->get_code());
+        }
+    }
+
+    for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
+        const WP::Device::Range &range = get_axis_range(i);
+        if (range.end > range.begin) {
+            set_bit(m_abs_mask, get_axis_at(i)->get_code());
+        }
+    }
+
+    m_masked = true;
+
+}
+
+
+void
+SourceDevice::set_timers(WP::Timers *timers)
+{
+
+    m_timers = timers;
+
+}
+
+
+int
+SourceDevice::get_fd() const
+{
+
+    return m_fd;
+
 }
 
 
 bool
-SourceDevice::next_event()
+SourceDevice::read_events()
 {
 
     if (m_fd < 0) return false;
 
-    const int i = poll(m_fds, 1, -1);
-    if (i == -1) {
-        if (errno != EINTR) {
-            perror("poll");
-            return false;
-        }
+    static const size_t s = sizeof(struct input_event);
+
+    const ssize_t r = read(m_fd, m_events + m_event_count, (WP_EVENT_BUFFER_SIZE - m_event_count) * s);
+    if (r < 0 && (errno == EINTR || errno == EAGAIN)) {
         return true;
+    } else if (r <= 0 || r % s != 0) {
+        if (m_fd != -1) {
+            perror("read");
+        }
+        return false;
     }
 
-    if (m_fds[0].revents & POLLIN) {
-        static struct input_event event;
-        static const size_t s = sizeof(struct input_event);
-        memset(&event, 0, s);
-
-        if (read(m_fd, &event, sizeof(event)) != s) {
-            if (m_fd != -1) {
-                perror("read");
+    m_stats.reads++;
+    m_stats.events += r / s;
+    m_event_count += r / s;
+
+
+    // deliver every complete frame, keep a trailing partial one for the next read
+    size_t start = 0;
+    for (size_t i = 0; i < m_event_count; ++i) {
+        if (m_events[i].type != EV_SYN) continue;
+
+        if (m_events[i].code == SYN_DROPPED) {
+            WP_LOG_INFO_RECORD(WP::Log::INPUT_DROPPED, this, 0, 0);
+            m_dropped = true;
+            m_stats.drops++;
+        } else if (m_events[i].code == SYN_REPORT) {
+            if (m_dropped) {
+                // everything up to and including this report is incomplete
+                m_dropped = false;
+                sync_state(true);
+            } else {
+                handle_frame(m_events + start, i + 1 - start);
             }
-            return false;
+            start = i + 1;
         }
+    }
 
-
-        switch (event.type) {
-        case EV_KEY: handle_key(event.code, event.value); break;
-        case EV_ABS: handle_abs(event.code, event.value); break;
-        default: break;
+    if (start == 0 && m_event_count == WP_EVENT_BUFFER_SIZE) {
+        // frame does not fit into the buffer
+        if (!m_dropped) {
+            handle_frame(m_events, m_event_count);
         }
+        start = m_event_count;
+    }
 
-        return true;
+    m_event_count -= start;
+    if (m_event_count > 0 && start > 0) {
+        memmove(m_events, m_events + start, m_event_count * s);
     }
 
-    return false;
+    return true;
 
 }
 
 
+const WP::SourceDevice::Stats &
+SourceDevice::get_stats() const
+{
+
+    return m_stats;
+
+}
+
 
-std::string
-SourceDevice::get_handler() const
+const WP::Histogram &
+SourceDevice::get_latency() const
 {
 
-    static const char *i_line = "I: ";
-    static const char *h_line = "H: ";
+    return m_latency;
+
+}
 
 
-    std::string str;
-    std::string line;
 
-    uint16_t vendor = 0;
-    uint16_t product = 0;
-    uint16_t version = 0;
-    std::string handler;
+void
+SourceDevice::sync_state(bool notify)
+{
 
+    std::vector<struct input_event> frame;
 
-    std::ifstream stream("/proc/bus/input/devices");
-    if (stream.fail()) {
-        perror("/proc/bus/input/devices");
-        return std::string();
+    unsigned long keys[KEY_CNT / BITS_PER_LONG + 1];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(m_fd, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+        perror("ioctl EVIOCGKEY");
+    } else {
+        for (size_t i = 0, c = get_button_count(); i < c; ++i) {
+            WP::Button *button = get_button_at(i);
+            const bool down = test_bit(keys, button->get_code());
+
+            if (notify) {
+                if (get_button_down(i) == down) continue;
+
+                struct input_event event = { };
+                event.type = EV_KEY;
+                event.code = button->get_code();
+                event.value = down;
+                frame.push_back(event);
+            } else {
+                set_button_down(i, down);
+
+                if (WP::Application::get_verbose()) {
+                    printf("[Input] button=\"%s\" state=\"%s\"\n", button->get_name().c_str(), down ? "pressed" : "released");
+                }
+            }
+        }
     }
-    str.assign((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
-
-
-    std::istringstream ss(str);
-    while (std::getline(ss, line)) {
-        if (line.compare(0, strlen(i_line), i_line) == 0) {
-            device_src_parse_i(line, &vendor, &product, &version);
-        } else if (line.compare(0, strlen(h_line), h_line) == 0) {
-            device_src_parse_h(line, &handler);
-        } else if (line.compare("") == 0) {
-            vendor = 0;
-            product = 0;
-            version = 0;
-            handler.clear();
+
+
+    for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
+        WP::Axis *axis = get_axis_at(i);
+
+        struct input_absinfo abs;
+        if (ioctl(m_fd, EVIOCGABS(axis->get_code()), &abs) < 0) {
+            perror("ioctl EVIOCGABS");
+            continue;
         }
 
+        if (notify) {
+            if (abs.value == get_axis_value(i)) continue;
+
+            struct input_event event = { };
+            event.type = EV_ABS;
+            event.code = axis->get_code();
+            event.value = abs.value;
+            frame.push_back(event);
+        } else {
+            set_axis_value(i, abs.value);
+            if (m_axis_filters[i] != nullptr) {
+                m_axis_filters[i]->reset(&m_filter_states[i], abs.value, WP::Utils::get_time());
+            }
 
-        if (vendor == get_vendor() && product == get_product() &&
-                /*version == get_version() &&*/ handler.size() > 0)
-        {
-            return handler;
+            if (WP::Application::get_verbose()) {
+                printf("[Input] axis=\"%s\" position=\"%d\"\n", axis->get_name().c_str(), abs.value);
+            }
         }
     }
 
-    return std::string();
+
+    if (notify && frame.size() > 0) {
+        struct input_event syn = { };
+        syn.type = EV_SYN;
+        syn.code = SYN_REPORT;
+        frame.push_back(syn);
+
+        handle_frame(frame.data(), frame.size());
+    }
 
 }
 
 
 void
-SourceDevice::handle_key(uint16_t code, int32_t value)
+SourceDevice::install_event_mask()
 {
 
-    WP::Button *button = get_button_by_code(code);
-    if (button != nullptr) {
-        button->set_down(value > 0);
-        onButtonChanged(button);
-    } else {
-        if (WP::Application::get_verbose()) {
-            printf("[Input] button: code=\"%d\" value=\"%d\" -> ignored\n", code, value);
+    if (!m_masked) return;
+
+
+    // the kernel neither queues nor wakes us up for anything outside the masks
+    struct input_mask mask;
+    const struct { uint16_t type; const unsigned long *codes; size_t size; } masks[] = {
+        { EV_KEY, m_key_mask, sizeof(m_key_mask) },
+        { EV_ABS, m_abs_mask, sizeof(m_abs_mask) },
+        { EV_MSC, nullptr, 0 },
+        { EV_REL, nullptr, 0 }
+    };
+
+    for (size_t i = 0; i < sizeof(masks) / sizeof(masks[0]); ++i) {
+        mask.type = masks[i].type;
+        mask.codes_size = masks[i].size;
+        mask.codes_ptr = (uint64_t) (uintptr_t) masks[i].codes;
+
+        if (ioctl(m_fd, EVIOCSMASK, &mask) < 0) {
+            if (WP::Application::get_verbose()) {
+                printf("[Input] kernel event masks not supported (%s), filtering in userspace\n", strerror(errno));
+            }
+            return;
         }
     }
 
+    if (WP::Application::get_verbose()) {
+        printf("[Input] kernel event masks installed\n");
+    }
+
 }
 
 
 void
-SourceDevice::handle_abs(uint16_t code, int32_t value)
+SourceDevice::handle_frame(const struct input_event *events, size_t count)
+{
+
+    // kernel timestamp of the frame, 0 if unknown
+    const struct input_event &report = events[count - 1];
+    const uint64_t time = m_monotonic && report.time.tv_sec != 0 ? WP::Utils::get_time(report.time) : 0;
+
+    size_t handled = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const struct input_event &event = events[i];
+        bool mapped = false;
+
+        switch (event.type) {
+        case EV_SYN: continue;
+        case EV_KEY: mapped = test_bit(m_key_mask, event.code) && handle_key(event.code, event.value, time); break;
+        case EV_ABS: mapped = test_bit(m_abs_mask, event.code) && handle_abs(event.code, event.value, time); break;
+        default: break;
+        }
+
+        if (mapped) {
+            ++handled;
+        } else {
+            m_stats.ignored++;
+        }
+    }
+
+    // a wakeup for nothing, the event masks should prevent these
+    if (handled < 1) {
+        m_stats.empty_frames++;
+    }
+
+    // time between the kernel reporting the frame and us handling it
+    if (time > 0) {
+        const uint64_t now = WP::Utils::get_time();
+        m_latency.add(now > time ? now - time : 0);
+    }
+
+    m_stats.frames++;
+    onFrame();
+
+}
+
+
+bool
+SourceDevice::handle_key(uint16_t code, int32_t value, uint64_t time)
+{
+
+    const uint16_t slot = get_button_index(code);
+    if (slot != WP_NO_INDEX) {
+        set_button_down(slot, value > 0);
+        onButtonChanged(slot, time);
+        return true;
+    } else {
+        WP_LOG_INFO_RECORD(WP::Log::INPUT_BUTTON_IGNORED, this, code, value);
+        return false;
+    }
+
+}
+
+
+bool
+SourceDevice::handle_abs(uint16_t code, int32_t value, uint64_t time)
 {
 
-    WP::Axis *axis = get_axis_by_code(code);
-    if (axis != nullptr) {
-        axis->set_value(value);
-        onAxisChanged(axis);
+    const uint16_t slot = get_axis_index(code);
+    if (slot != WP_NO_INDEX) {
+        const WP::Filter *filter = m_axis_filters[slot];
+        if (filter != nullptr) {
+            value = filter->apply(&m_filter_states[slot], value, time);
+
+            // one timer for all axes, it checks again when it fires instead of moving with every event
+            if (m_settle_time == 0 && m_timers != nullptr) {
+                m_settle_time = filter->get_settle_time(&m_filter_states[slot]);
+                if (m_settle_time != 0) m_timers->set_timer(this, m_settle_time);
+            }
+            if (value == get_axis_value(slot)) {
+                // jitter that smoothed out to the current value, nothing to map
+                m_stats.filtered++;
+                return true;
+            }
+        }
+
+        set_axis_value(slot, value);
+        onAxisChanged(slot, time);
+        return true;
     } else {
-        if (WP::Application::get_verbose()) {
-            printf("[Input] axis: code=\"%d\" value=\"%d\" -> ignored\n", code, value);
+        WP_LOG_INFO_RECORD(WP::Log::INPUT_AXIS_IGNORED, this, code, value);
+        return false;
+    }
+
+}
+
+
+void
+SourceDevice::onTimer(uint64_t now)
+{
+
+    m_settle_time = 0;
+    if (m_fd < 0) return;
+
+    uint64_t next = 0;
+    bool changed = false;
+
+    for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
+        const WP::Filter *filter = m_axis_filters[i];
+        if (filter == nullptr) continue;
+
+        const uint64_t time = filter->get_settle_time(&m_filter_states[i]);
+        if (time == 0) continue;
+        if (time > now) {
+            // events came in since the timer was set
+            if (next == 0 || time < next) next = time;
+            continue;
         }
+
+        const int32_t value = filter->settle(&m_filter_states[i]);
+        if (value == get_axis_value(i)) continue;
+
+        m_stats.settled++;
+        set_axis_value(i, value);
+        onAxisChanged(i, now);
+        changed = true;
+    }
+
+    // a frame of its own, the target writes it out
+    if (changed) onFrame();
+
+    if (next != 0) {
+        m_settle_time = next;
+        m_timers->set_timer(this, next);
     }
+
 }
 
 
@@ -20,37 +20,89 @@
 #define SOURCEDEVICE_H
 
 #include "device.h"
+#include "filter.h"
+#include "histogram.h"
+#include "timers.h"
 
-#include <poll.h>
+#include <linux/input.h>
+
+
+#define WP_EVENT_BUFFER_SIZE 64
+#define WP_BITS_TO_LONGS(n)  (((n) + 8 * sizeof(long) - 1) / (8 * sizeof(long)))
 
 
 namespace WP {
 
 
 
-class SourceDevice : public WP::Device
+class SourceDevice : public WP::Device, public WP::Timers::Listener
 {
 
 
 public:
+    struct Stats {
+        uint64_t reads;
+        uint64_t events;
+        uint64_t frames;
+        uint64_t drops;
+        uint64_t ignored;
+        uint64_t empty_frames;
+        uint64_t filtered; // axis events absorbed by a filter
+        uint64_t settled;  // filtered axes moved to their last raw value after going quiet
+    };
+
+
     SourceDevice(const std::string &name, uint16_t vendor, uint16_t product, uint16_t version,
                  std::vector<WP::Axis*> &axes, std::vector<WP::Button*> &buttons);
     ~SourceDevice();
 
     bool open();
+    // recorded events from a file or pipe instead of the event node, CLOCK_MONOTONIC timestamps
+    void open_replay(int fd);
     void close();
 
-    bool next_event();
+    void set_phys(const std::string &phys);
+    void set_uniq(const std::string &uniq);
+    // after the map is compiled: op ranges and the event masks
+    void load_ranges();
+    void set_timers(WP::Timers *timers);
 
+    int get_fd() const;
+    bool read_events();
 
-private:
-    int m_fd;
-    struct pollfd m_fds[1];
+    const WP::SourceDevice::Stats &get_stats() const;
+    const WP::Histogram &get_latency() const;
 
-    std::string get_handler() const;
 
-    inline void handle_key(uint16_t code, int32_t value);
-    inline void handle_abs(uint16_t code, int32_t value);
+private:
+    int m_fd;
+    std::string m_handler;
+    std::string m_phys;
+    std::string m_uniq;
+    struct input_event m_events[WP_EVENT_BUFFER_SIZE];
+    size_t m_event_count;
+    bool m_dropped;
+    bool m_monotonic;
+    bool m_masked;
+    bool m_opened;
+    unsigned long m_key_mask[WP_BITS_TO_LONGS(KEY_CNT)];
+    unsigned long m_abs_mask[WP_BITS_TO_LONGS(ABS_CNT)];
+    WP::SourceDevice::Stats m_stats;
+    WP::Histogram m_latency;
+    std::vector<const WP::Filter*> m_axis_filters; // per axis slot, nullptr if unfiltered
+    std::vector<WP::Filter::State> m_filter_states;
+    WP::Timers *m_timers;
+    uint64_t m_settle_time; // pending settle timer, 0 if none
+
+    void sync_state(bool notify);
+    void install_event_mask();
+
+    inline void handle_frame(const struct input_event *events, size_t count);
+
+    inline bool handle_key(uint16_t code, int32_t value, uint64_t time);
+    inline bool handle_abs(uint16_t code, int32_t value, uint64_t time);
+
+    void onTimer(uint64_t now);
 
 
 };
@@ -21,6 +21,9 @@
 #include "map.h"
 #include "button.h"
 #include "application.h"
+#include "log.h"
+#include "compiledmap.h"
+#include "utils.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -35,41 +38,7 @@
 #include <vector>
 #include <signal.h>
 #include <algorithm>
-
-
-
-static void
-send_event(int fd, uint16_t type, uint16_t code, int32_t value, bool syn)
-{
-
-    if (fd < 0) return;
-
-
-    static const size_t s = sizeof(struct input_event);
-    static struct input_event event;
-
-    memset(&event, 0, s);
-
-    event.type = type;
-    event.code = code;
-    event.value = value;
-    if (write(fd, &event, s) != s) {
-        perror("write");
-        return;
-    }
-
-    if (syn) {
-        event.type = EV_SYN;
-        event.code = 0;
-        event.value = 0;
-
-        if (write(fd, &event, s) != s) {
-            perror("write");
-            return;
-        }
-    }
-
-}
+#include <sys/uio.h>
 
 
 
@@ -83,7 +52,16 @@ TargetDevice::TargetDevice(const std::string &name, uint16_t vendor, uint16_t pr
 {
 
     m_map = nullptr;
+    m_compiled = nullptr;
     m_fd = -1;
+    m_frame.resize(get_axis_count() + get_button_count() + 1);
+    m_frame_count = 0;
+    m_frame_time = 0;
+    m_table_max_size = WP_TABLE_MAX_SIZE;
+    m_table_budget = WP_TABLE_BUDGET;
+    m_combines_dirty = false;
+    m_timers = nullptr;
+    memset(&m_stats, 0, sizeof(m_stats));
 
 }
 
@@ -176,6 +154,16 @@ success:
 }
 
 
+void
+TargetDevice::open_replay(int fd)
+{
+
+    close();
+    m_fd = fd;
+
+}
+
+
 void
 TargetDevice::close()
 {
@@ -189,11 +177,48 @@ TargetDevice::close()
 
 
 void
-TargetDevice::init(WP::Device *src, const WP::Map *map)
+TargetDevice::set_table_limits(uint32_t max_size, size_t budget)
+{
+
+    m_table_max_size = max_size;
+    m_table_budget = budget;
+
+}
+
+
+void
+TargetDevice::set_compiled_map(const WP::CompiledMap *compiled)
+{
+
+    m_compiled = compiled;
+
+}
+
+
+void
+TargetDevice::set_timers(WP::Timers *timers)
+{
+
+    m_timers = timers;
+
+}
+
+
+void
+TargetDevice::init(WP::Map *map)
 {
 
     m_map = map;
-    src->set_listener(this);
+    build_tables(map);
+
+    m_combine_values.assign(map->get_program_size(), 0);
+    m_combine_dirty.assign((map->get_combine_count() + 63) / 64, 0);
+    m_combines_dirty = false;
+
+    m_chords.init(map);
+    m_chords.set_listener(this);
+    m_macros.init(map);
+    m_macros.set_listener(this);
 
 
     if (WP::Application::get_verbose()) {
@@ -201,32 +226,95 @@ TargetDevice::init(WP::Device *src, const WP::Map *map)
     }
 
     for (size_t i = 0, c = get_axis_count(); i < c; ++i) {
-        WP::Axis *axis = get_axis_at(i);
+        const WP::Axis *axis = get_axis_at(i);
         if (axis->get_invert()) {
-            axis->set_value(axis->get_min()); // invert to max
+            set_axis_value(i, axis->get_max()); // inverted axes rest at max
 
             if (WP::Application::get_verbose()) {
                 printf("[Output] axis: (name=\"%s\" code=\"%d\" value=\"%d\")\n",
-                       axis->get_name().c_str(), axis->get_code(), axis->get_value());
+                       axis->get_name().c_str(), axis->get_code(), get_axis_value(i));
+            }
+            queue_event(EV_ABS, axis->get_code(), get_axis_value(i));
+        }
+    }
+
+    flush();
+
+}
+
+
+void
+TargetDevice::build_tables(WP::Map *map)
+{
+
+    // small source ranges are cheaper as one indexed load than as a multiply and shift
+    m_tables.clear();
+    if (m_compiled != nullptr) return; // has its own tables
+
+    for (size_t i = 0, s = map->get_program_size(); i < s; ++i) {
+        WP::MapOp *op = map->get_op_at(i);
+        if (op->code != WP::MapOp::AXIS_TO_AXIS && op->code != WP::MapOp::AXIS_TO_AXIS_CURVE) continue;
+
+        const WP::MapOp source = *op;
+        const bool curve = source.code == WP::MapOp::AXIS_TO_AXIS_CURVE;
+        const int32_t src_min = curve ? source.operands.curve.src_min : source.operands.scale.src_min;
+        const uint64_t size = (uint64_t) (curve ? source.operands.curve.src_range : source.operands.scale.src_range) + 1;
+        if (size > m_table_max_size) continue;
+        if ((m_tables.size() + size) * sizeof(int32_t) > m_table_budget) continue;
+
+        op->code = WP::MapOp::AXIS_TO_AXIS_TABLE;
+        op->operands.table.src_min = src_min;
+        op->operands.table.size = size;
+        op->operands.table.offset = m_tables.size();
+
+        for (uint64_t x = 0; x < size; ++x) {
+            const int32_t value = src_min + (int64_t) x;
+            if (curve) {
+                m_tables.push_back(WP::curve_axis_value(source.operands.curve, map->get_curves(), value));
+            } else {
+                m_tables.push_back(WP::scale_axis_value(source.operands.scale, value));
             }
-            send_event(m_fd, EV_ABS, axis->get_code(), axis->get_value(), true);
         }
+
+        m_stats.tables++;
+    }
+
+    m_stats.table_bytes = m_tables.size() * sizeof(int32_t);
+
+    if (WP::Application::get_verbose()) {
+        printf("[Output] lookup tables: count=\"%llu\" size=\"%llu bytes\"\n",
+               (unsigned long long) m_stats.tables, (unsigned long long) m_stats.table_bytes);
     }
 
+}
+
+
+void
+TargetDevice::sync(WP::Device *src)
+{
+
+    assert(m_map != nullptr);
+
+    src->set_listener(this);
+
 
     if (WP::Application::get_verbose()) {
-        printf("[Output] sync with input device...\n");
+        printf("[Output] sync with input device \"%s\"...\n", src->get_name().c_str());
     }
 
     for (size_t i = 0, c = src->get_button_count(); i < c; ++i) {
-        WP::Button *button = src->get_button_at(i);
-        if (button->get_down()) onDeviceButtonChanged(src, button);
+        if (src->get_button_down(i)) onDeviceButtonChanged(src, i, 0);
     }
 
     for (size_t i = 0, c = src->get_axis_count(); i < c; ++i) {
-        onDeviceAxisChanged(src, src->get_axis_at(i));
+        onDeviceAxisChanged(src, i, 0);
     }
 
+    // inputs which did not change leave their combine clean, but the output is not written yet
+    mark_combines();
+    update_combines();
+    flush();
+
     if (WP::Application::get_verbose()) {
         printf("[Output] sync done\n");
     }
@@ -234,25 +322,78 @@ TargetDevice::init(WP::Device *src, const WP::Map *map)
 }
 
 
+const WP::TargetDevice::Stats &
+TargetDevice::get_stats() const
+{
+
+    return m_stats;
+
+}
+
+
+const WP::Histogram &
+TargetDevice::get_latency() const
+{
+
+    return m_latency;
+
+}
+
+
+const WP::Chords &
+TargetDevice::get_chords() const
+{
+
+    return m_chords;
+
+}
+
+
+const WP::MacroPlayer &
+TargetDevice::get_macros() const
+{
+
+    return m_macros;
+
+}
+
+
 void
-TargetDevice::onDeviceAxisChanged(WP::Device *src_device, WP::Axis *axis)
+TargetDevice::onDeviceAxisChanged(WP::Device *src, uint16_t slot, uint64_t time)
 {
 
     assert(m_map != nullptr);
 
+    set_frame_time(time);
 
-    const auto entries = m_map->get_entries_for_src(axis);
-    if (entries == nullptr) return;
 
-    for (size_t i = 0, s = entries->size(); i < s; ++i) {
-        const WP::MapEntry *entry = (*entries)[i];
+    const WP::Device::Range &range = src->get_axis_range(slot);
+    const WP::MapOp *ops = m_map->get_program();
+    const int32_t value = src->get_axis_value(slot);
 
-        switch (entry->get_target()->get_type()) {
-        case WP::EventSource::TYPE_BUTTON:
-            handle_axis_to_button(axis, (WP::Button*) entry->get_target(), (WP::AxisToButtonData*) entry->get_data());
+    if (m_compiled != nullptr) {
+        if (range.end > range.begin) m_compiled->dispatch(this, range.begin, value);
+        return;
+    }
+
+    for (uint32_t i = range.begin; i < range.end; ++i) {
+        const WP::MapOp &op = ops[i];
+
+        switch (op.code) {
+        case WP::MapOp::AXIS_TO_AXIS:
+            handle_axis_to_axis(src, slot, op, WP::scale_axis_value(op.operands.scale, value));
+            break;
+        case WP::MapOp::AXIS_TO_AXIS_TABLE:
+            handle_axis_to_axis(src, slot, op, WP::lookup_axis_value(op.operands.table, m_tables.data(), value));
             break;
-        case WP::EventSource::TYPE_AXIS:
-            handle_axis_to_axis(axis, (WP::Axis*) entry->get_target());
+        case WP::MapOp::AXIS_TO_AXIS_CURVE:
+            handle_axis_to_axis(src, slot, op, WP::curve_axis_value(op.operands.curve, m_map->get_curves(), value));
+            break;
+        case WP::MapOp::AXIS_TO_COMBINE:
+            set_combine_input(i, op.slot, WP::scale_axis_value(op.operands.scale, value));
+            break;
+        case WP::MapOp::AXIS_TO_BUTTON:
+            handle_axis_to_button(src, slot, op, value);
             break;
         default: assert(false); break;
         }
@@ -262,25 +403,56 @@ TargetDevice::onDeviceAxisChanged(WP::Device *src_device, WP::Axis *axis)
 
 
 void
-TargetDevice::onDeviceButtonChanged(WP::Device *src_device, WP::Button *button)
+TargetDevice::onDeviceButtonChanged(WP::Device *src, uint16_t slot, uint64_t time)
 {
 
     assert(m_map != nullptr);
 
+    set_frame_time(time);
+
+
+    const WP::Device::Range &range = src->get_button_range(slot);
+    const WP::MapOp *ops = m_map->get_program();
+    const bool down = src->get_button_down(slot);
 
-    const auto entries = m_map->get_entries_for_src(button);
-    if (entries == nullptr) return;
+    // chord buttons go through the chord engine first, it holds back or swallows their own ops
+    if (range.end > range.begin && ops[range.begin].code == WP::MapOp::BUTTON_TO_CHORD) {
+        const bool pass = m_chords.button_changed(src, slot, ops[range.begin].slot, down, time);
+        update_timer();
+        if (!pass) return;
+    }
+
+    run_button_ops(src, slot, down);
+
+}
 
-    for (size_t i = 0, s = entries->size(); i < s; ++i) {
-        const WP::MapEntry *entry = (*entries)[i];
 
-        switch (entry->get_target()->get_type()) {
-        case WP::EventSource::TYPE_BUTTON:
-            handle_button_to_button(button, (WP::Button*) entry->get_target());
+void
+TargetDevice::run_button_ops(WP::Device *src, uint16_t slot, bool down)
+{
+
+    const WP::Device::Range &range = src->get_button_range(slot);
+    const WP::MapOp *ops = m_map->get_program();
+
+    if (m_compiled != nullptr) {
+        if (range.end > range.begin) m_compiled->dispatch(this, range.begin, down);
+        return;
+    }
+
+    for (uint32_t i = range.begin; i < range.end; ++i) {
+        const WP::MapOp &op = ops[i];
+
+        switch (op.code) {
+        case WP::MapOp::BUTTON_TO_BUTTON:
+            handle_button_to_button(src, slot, op, down);
             break;
-        case WP::EventSource::TYPE_AXIS:
-            handle_button_to_axis(button, (WP::Axis*) entry->get_target(), (WP::ButtonToAxisData*) entry->get_data());
+        case WP::MapOp::BUTTON_TO_AXIS:
+            handle_button_to_axis(src, slot, op, down);
             break;
+        case WP::MapOp::BUTTON_TO_MACRO:
+            if (down) start_macro(op.slot);
+            break;
+        case WP::MapOp::BUTTON_TO_CHORD: break;
         default: assert(false); break;
         }
     }
@@ -289,79 +461,307 @@ TargetDevice::onDeviceButtonChanged(WP::Device *src_device, WP::Button *button)
 
 
 void
-TargetDevice::handle_axis_to_axis(const WP::Axis *src_axis, WP::Axis *target_axis)
+TargetDevice::onDeviceFrame(WP::Device *)
 {
 
-    target_axis->set_value_percent(src_axis->get_value_percent());
+    update_combines();
+    flush();
 
-    if (WP::Application::get_verbose()) {
-        printf("[Input] axis: (name=\"%s\" code=\"%d\" value=\"%d\") -> [Output] axis: (name=\"%s\" code=\"%d\" value=\"%d\")\n",
-               src_axis->get_name().c_str(), src_axis->get_code(), src_axis->get_value(),
-               target_axis->get_name().c_str(), target_axis->get_code(), target_axis->get_value());
+}
+
+
+void
+TargetDevice::emit_axis(uint16_t slot, int32_t value, uint8_t flags)
+{
+
+    if (suppress(flags, get_axis_value(slot) == value)) return;
+
+    set_axis_value(slot, value);
+    WP_LOG_EVENT_RECORD(WP::Log::OUTPUT_AXIS, nullptr, 0, 0, this, slot, value);
+
+    queue_event(EV_ABS, get_axis_at(slot)->get_code(), value);
+
+}
+
+
+void
+TargetDevice::emit_button(uint16_t slot, bool down, uint8_t flags)
+{
+
+    if (suppress(flags, get_button_down(slot) == down)) return;
+
+    set_button_down(slot, down);
+    WP_LOG_EVENT_RECORD(WP::Log::OUTPUT_BUTTON, nullptr, 0, 0, this, slot, down);
+
+    queue_event(EV_KEY, get_button_at(slot)->get_code(), down);
+
+}
+
+
+void
+TargetDevice::set_combine_input(uint32_t op, uint16_t combine, int32_t value)
+{
+
+    m_stats.combine_inputs++;
+    if (m_combine_values[op] == value && !(m_map->get_combines()[combine].flags & WP::MapOp::FLAG_HEARTBEAT)) return;
+
+    // evaluated once at the end of the frame, however many inputs changed
+    m_combine_values[op] = value;
+    m_combine_dirty[combine / 64] |= 1ULL << (combine % 64);
+    m_combines_dirty = true;
+
+}
+
+
+void
+TargetDevice::mark_combines()
+{
+
+    const size_t count = m_map->get_combine_count();
+    if (count == 0) return;
+
+    std::fill(m_combine_dirty.begin(), m_combine_dirty.end(), ~0ULL);
+    if (count % 64 != 0) {
+        m_combine_dirty.back() = (1ULL << (count % 64)) - 1;
     }
+    m_combines_dirty = true;
+
+}
+
+
+void
+TargetDevice::update_combines()
+{
+
+    if (!m_combines_dirty) return;
+    m_combines_dirty = false;
 
-    send_event(m_fd, EV_ABS, target_axis->get_code(), target_axis->get_value(), true);
+    const WP::MapCombine *combines = m_map->get_combines();
+    const uint32_t *inputs = m_map->get_combine_inputs();
+
+    for (size_t w = 0, s = m_combine_dirty.size(); w < s; ++w) {
+        uint64_t bits = m_combine_dirty[w];
+        m_combine_dirty[w] = 0;
+
+        while (bits != 0) {
+            const WP::MapCombine &combine = combines[w * 64 + __builtin_ctzll(bits)];
+            bits &= bits - 1;
+
+            m_stats.combine_updates++;
+            emit_axis(combine.slot, WP::combine_axis_value(combine, m_combine_values.data(), inputs), combine.flags);
+        }
+    }
 
 }
 
 
 void
-TargetDevice::handle_axis_to_button(const WP::Axis *src_axis, WP::Button *target_button, const WP::AxisToButtonData *data)
+TargetDevice::start_macro(uint16_t macro)
 {
 
-    assert(data != nullptr);
+    m_macros.start(macro, WP::Utils::get_time());
+    update_timer();
 
-    const bool in_range = src_axis->get_value() >= data->get_range_start() && src_axis->get_value() <= data->get_range_end();
-    if (target_button->get_down() == in_range) return;
+}
 
-    target_button->set_down(in_range);
 
-    if (WP::Application::get_verbose()) {
-        printf("[Input] axis: (name=\"%s\" code=\"%d\" value=\"%d\") -> [Output] button: (name=\"%s\" code=\"%d\" down=\"%s\")\n",
-               src_axis->get_name().c_str(), src_axis->get_code(), src_axis->get_value(),
-               target_button->get_name().c_str(), target_button->get_code(),
-               target_button->get_down() ? "true" : "false");
+void
+TargetDevice::update_timer()
+{
+
+    if (m_timers == nullptr) return;
+
+    const uint64_t chords = m_chords.get_deadline();
+    const uint64_t macros = m_macros.get_deadline();
+    m_timers->set_timer(this, chords == 0 || (macros != 0 && macros < chords) ? macros : chords);
+
+}
+
+
+void
+TargetDevice::onTimer(uint64_t now)
+{
+
+    m_chords.expire(now);
+    m_macros.expire(now);
+    update_timer();
+    flush();
+
+}
+
+
+void
+TargetDevice::onChordChanged(const WP::MapChord &chord, bool down)
+{
+
+    emit_button(chord.slot, down, chord.flags);
+
+}
+
+
+void
+TargetDevice::onChordButtonPassed(WP::Device *src, uint16_t slot)
+{
+
+    // a press of its own frame, the release may follow right after it
+    run_button_ops(src, slot, true);
+    flush();
+
+}
+
+
+void
+TargetDevice::onMacroStep(const WP::MapMacroStep &step)
+{
+
+    switch (step.type) {
+    case WP::Macro::Step::PRESS: emit_button(step.slot, true, 0); break;
+    case WP::Macro::Step::RELEASE: emit_button(step.slot, false, 0); break;
+    case WP::Macro::Step::AXIS: emit_axis(step.slot, step.value, 0); break;
+    default: break;
     }
 
-    send_event(m_fd, EV_KEY, target_button->get_code(), target_button->get_down(), true);
+    // every step is a frame of its own, a press and a release without delay still register
+    flush();
+
+}
+
+
+bool
+TargetDevice::suppress(uint8_t flags, bool unchanged)
+{
+
+    // the target state is what was last written to uinput
+    if (!unchanged || (flags & WP::MapOp::FLAG_HEARTBEAT)) return false;
+
+    m_stats.suppressed++;
+    return true;
 
 }
 
 
 void
-TargetDevice::handle_button_to_button(const WP::Button *src_button, WP::Button *target_button)
+TargetDevice::handle_axis_to_axis(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, int32_t value)
 {
 
-    target_button->set_down(src_button->get_down());
+    if (suppress(op.flags, get_axis_value(op.slot) == value)) return;
 
-    if (WP::Application::get_verbose()) {
-        printf("[Input] button: (name=\"%s\" code=\"%d\") -> [Output] button: (name=\"%s\" code=\"%d\") down=\"%s\"\n",
-               src_button->get_name().c_str(), src_button->get_code(), target_button->get_name().c_str(),
-               target_button->get_code(), target_button->get_down() ? "true" : "false");
+    set_axis_value(op.slot, value);
+    WP_LOG_EVENT_RECORD(WP::Log::AXIS_TO_AXIS, src, src_slot, src->get_axis_value(src_slot), this, op.slot, value);
+
+    queue_event(EV_ABS, get_axis_at(op.slot)->get_code(), value);
+
+}
+
+
+void
+TargetDevice::handle_axis_to_button(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, int32_t value)
+{
+
+    const bool in_range = value >= op.operands.range[0] && value <= op.operands.range[1];
+    if (suppress(op.flags, get_button_down(op.slot) == in_range)) return;
+
+    set_button_down(op.slot, in_range);
+    WP_LOG_EVENT_RECORD(WP::Log::AXIS_TO_BUTTON, src, src_slot, value, this, op.slot, in_range);
+
+    queue_event(EV_KEY, get_button_at(op.slot)->get_code(), in_range);
+
+}
+
+
+void
+TargetDevice::handle_button_to_button(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, bool down)
+{
+
+    if (suppress(op.flags, get_button_down(op.slot) == down)) return;
+
+    set_button_down(op.slot, down);
+    WP_LOG_EVENT_RECORD(WP::Log::BUTTON_TO_BUTTON, src, src_slot, down, this, op.slot, down);
+
+    queue_event(EV_KEY, get_button_at(op.slot)->get_code(), down);
+
+}
+
+
+void
+TargetDevice::handle_button_to_axis(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, bool down)
+{
+
+    const int32_t value = op.operands.values[down ? 1 : 0];
+    if (suppress(op.flags, get_axis_value(op.slot) == value)) return;
+
+    set_axis_value(op.slot, value);
+    WP_LOG_EVENT_RECORD(WP::Log::BUTTON_TO_AXIS, src, src_slot, down, this, op.slot, value);
+
+    queue_event(EV_ABS, get_axis_at(op.slot)->get_code(), value);
+
+}
+
+
+void
+TargetDevice::set_frame_time(uint64_t time)
+{
+
+    // the output frame originates from the oldest input it contains
+    if (time > 0 && (m_frame_time == 0 || time < m_frame_time)) {
+        m_frame_time = time;
     }
 
-    send_event(m_fd, EV_KEY, target_button->get_code(), target_button->get_down(), true);
+}
+
+
+void
+TargetDevice::queue_event(uint16_t type, uint16_t code, int32_t value)
+{
+
+    // a flush here would split the frame, heartbeats may write an output more than once
+    if (m_frame_count == m_frame.size()) {
+        m_frame.resize(m_frame.size() * 2);
+    }
+
+    struct input_event &event = m_frame[m_frame_count++];
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.code = code;
+    event.value = value;
 
 }
 
 
 void
-TargetDevice::handle_button_to_axis(const WP::Button *src_button, WP::Axis *target_axis, const WP::ButtonToAxisData *data)
+TargetDevice::flush()
 {
 
-    if (src_button->get_down()) {
-        target_axis->set_value(data->get_value_pressed());
-    } else {
-        target_axis->set_value(data->get_value_released());
+    if (m_frame_count < 1 || m_fd < 0) {
+        m_frame_count = 0;
+        m_frame_time = 0;
+        return;
     }
 
-    if (WP::Application::get_verbose()) {
-        printf("[Input] button: (name=\"%s\" code=\"%d\") -> [Output] axis: (name=\"%s\" code=\"%d\") value=\"%d\"\n",
-               src_button->get_name().c_str(), src_button->get_code(), target_axis->get_name().c_str(),
-               target_axis->get_code(), target_axis->get_value());
+
+    static const struct input_event syn = { };
+    struct iovec iov[2];
+    iov[0].iov_base = m_frame.data();
+    iov[0].iov_len = m_frame_count * sizeof(struct input_event);
+    iov[1].iov_base = (void*) &syn;
+    iov[1].iov_len = sizeof(syn);
+
+    if (writev(m_fd, iov, 2) != (ssize_t) (iov[0].iov_len + iov[1].iov_len)) {
+        perror("writev");
     }
 
-    send_event(m_fd, EV_ABS, target_axis->get_code(), target_axis->get_value(), true);
+    // every event used to cost a write() for the value and one for its own SYN_REPORT
+    m_stats.frames++;
+    m_stats.events += m_frame_count;
+    m_stats.syscalls_saved += m_frame_count * 2 - 1;
+    m_frame_count = 0;
+
+    // end to end: kernel timestamp of the input until the output is written
+    if (m_frame_time > 0) {
+        const uint64_t now = WP::Utils::get_time();
+        m_latency.add(now > m_frame_time ? now - m_frame_time : 0);
+        m_frame_time = 0;
+    }
 
 }
 
@@ -21,41 +21,112 @@
 
 
 #include "device.h"
+#include "histogram.h"
+#include "chords.h"
+#include "macroplayer.h"
+#include "timers.h"
 
+#include <linux/input.h>
+
+
+#define WP_TABLE_MAX_SIZE 4096
+#define WP_TABLE_BUDGET (256 * 1024)
 
 
 namespace WP {
 
 
-class AxisToButtonData;
-class ButtonToAxisData;
 class Map;
-class TargetDevice : public WP::Device, public WP::Device::Listener
+struct CompiledMap;
+struct MapOp;
+class TargetDevice : public WP::Device, public WP::Device::Listener, public WP::Timers::Listener, public WP::Chords::Listener,
+                     public WP::MacroPlayer::Listener
 {
 
 
 public:
+    struct Stats {
+        uint64_t frames;
+        uint64_t events;
+        uint64_t syscalls_saved;
+        uint64_t suppressed;
+        uint64_t tables;
+        uint64_t table_bytes;
+        uint64_t combine_inputs;  // input changes of combined axes
+        uint64_t combine_updates; // combined axes evaluated, at most once per frame each
+    };
+
+
     TargetDevice(const std::string &name, uint16_t vendor, uint16_t product, uint16_t version,
                  std::vector<WP::Axis*> &axes, std::vector<WP::Button*> &buttons);
     ~TargetDevice();
 
     bool open();
+    // frames go to a file or pipe instead of a uinput device
+    void open_replay(int fd);
     void close();
-    void init(WP::Device *src, const WP::Map *map);
+    void set_table_limits(uint32_t max_size, size_t budget);
+    void set_compiled_map(const WP::CompiledMap *compiled);
+    void set_timers(WP::Timers *timers);
+    void init(WP::Map *map);
+    void sync(WP::Device *src);
+
+    // used by compiled maps
+    void emit_axis(uint16_t slot, int32_t value, uint8_t flags);
+    void emit_button(uint16_t slot, bool down, uint8_t flags);
+    void set_combine_input(uint32_t op, uint16_t combine, int32_t value);
+    void start_macro(uint16_t macro);
+
+    const WP::TargetDevice::Stats &get_stats() const;
+    const WP::Histogram &get_latency() const;
+    const WP::Chords &get_chords() const;
+    const WP::MacroPlayer &get_macros() const;
 
 
 private:
     const WP::Map *m_map;
+    const WP::CompiledMap *m_compiled;
     int m_fd;
-
-    void onDeviceAxisChanged(WP::Device *device, WP::Axis *axis);
-    void onDeviceButtonChanged(WP::Device *device, WP::Button *button);
-
-    inline void handle_axis_to_axis(const WP::Axis *src_axis, WP::Axis *target_axis);
-    inline void handle_axis_to_button(const WP::Axis *src_axis, WP::Button *target_button, const WP::AxisToButtonData *data);
-
-    inline void handle_button_to_button(const WP::Button *src_button, WP::Button *target_button);
-    inline void handle_button_to_axis(const WP::Button *src_button, WP::Axis *target_axis, const WP::ButtonToAxisData *data);
+    std::vector<struct input_event> m_frame; // a slot per output axis and button, grows if a frame needs more
+    size_t m_frame_count;
+    uint64_t m_frame_time;
+    WP::TargetDevice::Stats m_stats;
+    WP::Histogram m_latency;
+    std::vector<int32_t> m_tables;
+    uint32_t m_table_max_size;
+    size_t m_table_budget;
+    std::vector<int32_t> m_combine_values; // last input of every AXIS_TO_COMBINE op, by program index
+    std::vector<uint64_t> m_combine_dirty; // combines with a changed input in this frame
+    bool m_combines_dirty;
+    WP::Chords m_chords;
+    WP::MacroPlayer m_macros;
+    WP::Timers *m_timers;
+
+    void build_tables(WP::Map *map);
+    void mark_combines();
+    void update_combines();
+    void update_timer();
+    void run_button_ops(WP::Device *src, uint16_t slot, bool down);
+
+    inline void set_frame_time(uint64_t time);
+    inline void queue_event(uint16_t type, uint16_t code, int32_t value);
+    void flush();
+
+    void onDeviceAxisChanged(WP::Device *device, uint16_t slot, uint64_t time);
+    void onDeviceButtonChanged(WP::Device *device, uint16_t slot, uint64_t time);
+    void onDeviceFrame(WP::Device *device);
+    void onTimer(uint64_t now);
+    void onChordChanged(const WP::MapChord &chord, bool down);
+    void onChordButtonPassed(WP::Device *src, uint16_t slot);
+    void onMacroStep(const WP::MapMacroStep &step);
+
+    inline bool suppress(uint8_t flags, bool unchanged);
+
+    inline void handle_axis_to_axis(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, int32_t value);
+    inline void handle_axis_to_button(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, int32_t value);
+
+    inline void handle_button_to_button(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, bool down);
+    inline void handle_button_to_axis(const WP::Device *src, uint16_t src_slot, const WP::MapOp &op, bool down);
 
 
 };
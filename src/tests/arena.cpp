@@ -0,0 +1,183 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "../3rdparty/json/json.hpp"
+#include "../arena.h"
+#include "../config.h"
+#include "../map.h"
+
+
+#define WP_TEST_OBJECTS 10000
+
+
+static uint64_t g_wp_news = 0;
+static uint64_t g_wp_deletes = 0;
+
+
+
+void *
+operator new(size_t size)
+{
+
+    g_wp_news++;
+    void *ptr = malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+
+}
+
+
+void
+operator delete(void *ptr) noexcept
+{
+
+    if (ptr == nullptr) return;
+    g_wp_deletes++;
+    free(ptr);
+
+}
+
+
+void
+operator delete(void *ptr, size_t) noexcept
+{
+
+    operator delete(ptr);
+
+}
+
+
+
+struct Counted
+{
+
+    static int destroyed;
+    static int last;
+
+    int index;
+    char payload[40];
+
+    Counted(int i) : index(i) { }
+    ~Counted() {
+        // newest first
+        if (last != -1 && index != last - 1) abort();
+        last = index;
+        destroyed++;
+    }
+
+};
+
+int Counted::destroyed = 0;
+int Counted::last = -1;
+
+
+
+// objects created in an arena cost no heap allocation of their own
+static bool
+check_arena()
+{
+
+    const uint64_t news = g_wp_news;
+    uint64_t blocks;
+    {
+        WP::Arena arena;
+        for (int i = 0; i < WP_TEST_OBJECTS; ++i) {
+            arena.create<Counted>(i);
+        }
+        blocks = arena.get_stats().blocks;
+    }
+
+    // object and destructor record of every object
+    const uint64_t bytes = WP_TEST_OBJECTS * (sizeof(Counted) + 3 * sizeof(void*));
+    const uint64_t max_blocks = bytes / WP_ARENA_BLOCK_SIZE + 1;
+
+    printf("arena: objects=\"%d\" blocks=\"%llu\" heap allocations=\"%llu\" destroyed=\"%d\"\n", WP_TEST_OBJECTS,
+           (unsigned long long) blocks, (unsigned long long) (g_wp_news - news), Counted::destroyed);
+
+    return g_wp_news == news && blocks <= max_blocks && Counted::destroyed == WP_TEST_OBJECTS;
+
+}
+
+
+// every device config, axis, button and map entry of a profile sits in the config arena
+static bool
+check_config(const char *file)
+{
+
+    std::ifstream stream(file);
+    nlohmann::json json;
+    stream >> json;
+    const size_t entries = json["map"].size();
+
+    const uint64_t news = g_wp_news;
+    const uint64_t deletes = g_wp_deletes;
+    bool ok;
+    {
+        WP::Map map;
+        WP::Config config;
+        if (!config.load(file, &map)) {
+            printf("%s: failed to load\n", file);
+            return false;
+        }
+
+        size_t expected = config.inputs.size() + config.output.axes.size() + config.output.buttons.size() + entries;
+        for (size_t i = 0, s = config.inputs.size(); i < s; ++i) {
+            expected += config.inputs[i]->axes.size() + config.inputs[i]->buttons.size();
+        }
+
+        const WP::Arena::Stats &stats = config.arena.get_stats();
+        printf("%s: objects=\"%llu\" expected=\"%llu\" blocks=\"%llu\" bytes=\"%llu\" heap allocations=\"%llu\"\n", file,
+               (unsigned long long) stats.objects, (unsigned long long) expected, (unsigned long long) stats.blocks,
+               (unsigned long long) stats.bytes, (unsigned long long) (g_wp_news - news));
+
+        ok = stats.objects == expected && stats.blocks == 1;
+    }
+
+    // names and containers still use the heap, all of it is gone with the config
+    if (g_wp_news - news != g_wp_deletes - deletes) {
+        printf("%s: %llu heap allocations not freed\n", file,
+               (unsigned long long) ((g_wp_news - news) - (g_wp_deletes - deletes)));
+        return false;
+    }
+
+    return ok;
+
+}
+
+
+
+int
+main(int argc, char **argv)
+{
+
+    bool ok = check_arena();
+
+    for (int i = 1; i < argc; ++i) {
+        ok = check_config(argv[i]) && ok;
+    }
+
+    return ok ? 0 : 1;
+
+}
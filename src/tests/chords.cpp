@@ -0,0 +1,396 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "../button.h"
+#include "../chords.h"
+#include "../config.h"
+#include "../map.h"
+#include "../sourcedevice.h"
+#include "../targetdevice.h"
+
+
+#define MS 1000000ULL
+
+// random button activity played after the scripted checks
+#define WP_TRACE_LENGTH (600000 * MS)
+
+
+
+// plays button events through a source device into the target device and keeps what it writes
+class Replay
+{
+
+public:
+    struct Output {
+        uint64_t time;
+        uint16_t code;
+        int32_t value;
+    };
+
+
+    Replay(WP::SourceDevice *src, WP::TargetDevice *target)
+        : m_src(src), m_target(target) {
+        m_src_fd = -1;
+        m_target_fd = -1;
+    }
+
+    ~Replay() {
+        if (m_src_fd != -1) ::close(m_src_fd);
+        if (m_target_fd != -1) ::close(m_target_fd);
+    }
+
+    bool open() {
+        int src[2];
+        int target[2];
+        if (pipe2(src, O_NONBLOCK) != 0 || pipe2(target, O_NONBLOCK) != 0) {
+            perror("pipe2");
+            return false;
+        }
+
+        m_src->open_replay(src[0]);
+        m_target->open_replay(target[1]);
+        m_src_fd = src[1];
+        m_target_fd = target[0];
+        return true;
+    }
+
+    // value as in the kernel event: 0 released, 1 pressed, 2 repeat
+    void button(const char *name, int32_t value, uint64_t time) {
+        advance(time);
+
+        struct input_event frame[2] = { };
+        frame[0].time.tv_sec = time / 1000000000;
+        frame[0].time.tv_usec = (time % 1000000000) / 1000;
+        frame[0].type = EV_KEY;
+        frame[0].code = get_code(m_src, name);
+        frame[0].value = value;
+        frame[1].time = frame[0].time;
+        frame[1].type = EV_SYN;
+        frame[1].code = SYN_REPORT;
+
+        if (write(m_src_fd, frame, sizeof(frame)) != sizeof(frame) || !m_src->read_events()) {
+            perror("replay");
+        }
+        collect(time);
+    }
+
+    // timers fire right at the deadline
+    void advance(uint64_t time) {
+        const WP::Chords &chords = m_target->get_chords();
+        while (chords.get_deadline() != 0 && chords.get_deadline() <= time) {
+            const uint64_t deadline = chords.get_deadline();
+            static_cast<WP::Timers::Listener*>(m_target)->onTimer(deadline);
+            collect(deadline);
+        }
+    }
+
+    int output(const char *name) const {
+        return m_target->get_button_down(m_target->get_button_index(get_code(m_target, name))) ? 1 : 0;
+    }
+
+    uint16_t get_output_code(const char *name) const {
+        return get_code(m_target, name);
+    }
+
+    const std::vector<Replay::Output> &get_outputs() const {
+        return m_outputs;
+    }
+
+    static uint16_t get_code(const WP::Device *device, const char *name) {
+        for (size_t i = 0, c = device->get_button_count(); i < c; ++i) {
+            if (device->get_button_at(i)->get_name().compare(name) == 0) return device->get_button_at(i)->get_code();
+        }
+        return 0;
+    }
+
+
+private:
+    WP::SourceDevice *m_src;
+    WP::TargetDevice *m_target;
+    int m_src_fd;
+    int m_target_fd;
+    std::vector<Replay::Output> m_outputs;
+
+    // what the target device wrote, stamped with the time it was written
+    void collect(uint64_t time) {
+        struct input_event events[64];
+        ssize_t r;
+        while ((r = read(m_target_fd, events, sizeof(events))) > 0) {
+            for (size_t i = 0, c = r / sizeof(struct input_event); i < c; ++i) {
+                if (events[i].type != EV_KEY) continue;
+                m_outputs.push_back(Replay::Output { time, events[i].code, events[i].value });
+            }
+        }
+    }
+
+};
+
+
+
+static int g_wp_failed = 0;
+static uint32_t g_wp_seed = 7;
+
+
+static void
+expect(const Replay &replay, const char *when, int x, int y, int z)
+{
+
+    const int ox = replay.output("X");
+    const int oy = replay.output("Y");
+    const int oz = replay.output("Z");
+    const bool ok = ox == x && oy == y && oz == z;
+    if (!ok) g_wp_failed++;
+
+    printf("%-40s X=%d Y=%d Z=%d%s\n", when, ox, oy, oz, ok ? "" : "  <- FAILED");
+
+}
+
+
+static uint64_t
+get_random(uint64_t min, uint64_t max)
+{
+
+    // xorshift, the trace is the same everywhere
+    g_wp_seed ^= g_wp_seed << 13;
+    g_wp_seed ^= g_wp_seed >> 17;
+    g_wp_seed ^= g_wp_seed << 5;
+    return min + g_wp_seed % (max - min + 1);
+
+}
+
+
+// first press of the code in [begin,end], 0 if none
+static uint64_t
+find_press(const std::vector<Replay::Output> &outputs, size_t *pos, uint16_t code, uint64_t begin, uint64_t end)
+{
+
+    while (*pos < outputs.size() && outputs[*pos].time < begin) ++*pos;
+
+    for (size_t i = *pos; i < outputs.size() && outputs[i].time <= end; ++i) {
+        if (outputs[i].code == code && outputs[i].value == 1) return outputs[i].time;
+    }
+    return 0;
+
+}
+
+
+// ten minutes of taps, chords pressed together and chords on a button held down first, one
+// after the other; every output press has to belong to what the player meant
+static void
+replay_trace(Replay *replay, const WP::Chords &chords, uint64_t t)
+{
+
+    enum Kind { SINGLE, CHORD, HELD_CHORD };
+    struct Intent {
+        Kind kind;
+        const char *button;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    std::vector<Intent> intents;
+    const size_t first_output = replay->get_outputs().size();
+    const uint64_t end = t + WP_TRACE_LENGTH;
+
+    while (t < end) {
+        t += get_random(100, 500) * MS;
+
+        const uint64_t kind = get_random(0, 9);
+        const char *a = get_random(0, 1) ? "A" : "B";
+        const char *b = a[0] == 'A' ? "B" : "A";
+
+        if (kind < 4) {
+            // a tap or a press held past the window
+            const uint64_t up = t + get_random(20, 250) * MS;
+            replay->button(a, 1, t);
+            replay->button(a, 0, up);
+            intents.push_back(Intent { SINGLE, a, t, up });
+            t = up;
+        } else if (kind < 7) {
+            // both buttons within 35 ms, in any order
+            const uint64_t second = t + get_random(0, 35) * MS;
+            const uint64_t up = second + get_random(100, 400) * MS;
+            replay->button(a, 1, t);
+            replay->button(b, 1, second);
+            replay->button(a, 0, up);
+            replay->button(b, 0, up + get_random(0, 50) * MS);
+            intents.push_back(Intent { CHORD, a, t, up });
+            t = up + 50 * MS;
+        } else {
+            // a shift paddle held down first, the second button pressed long after the window
+            const uint64_t second = t + get_random(100, 800) * MS;
+            const uint64_t second_up = second + get_random(50, 150) * MS;
+            const uint64_t up = second_up + get_random(10, 200) * MS;
+            replay->button(a, 1, t);
+            replay->button(b, 1, second);
+            replay->button(b, 0, second_up);
+            replay->button(a, 0, up);
+            intents.push_back(Intent { HELD_CHORD, a, second, second_up });
+            t = up;
+        }
+    }
+    replay->advance(t + 1000 * MS);
+
+
+    const std::vector<Replay::Output> &outputs = replay->get_outputs();
+    const uint16_t chord_code = replay->get_output_code("Z");
+    size_t pos = first_output;
+    uint64_t chord_presses = 0;
+    for (size_t i = first_output; i < outputs.size(); ++i) {
+        if (outputs[i].code == chord_code && outputs[i].value == 1) chord_presses++;
+    }
+
+    // own output of a single press by its delay: up to 10, 20, .. 50 ms and more than 50 ms
+    uint64_t delays[6] = { };
+    uint64_t singles = 0, lost = 0, leaked = 0, intended = 0, hits = 0;
+
+    for (const Intent &intent : intents) {
+        const uint16_t own = replay->get_output_code(intent.button[0] == 'A' ? "X" : "Y");
+        const uint64_t chord = find_press(outputs, &pos, chord_code, intent.begin, intent.end);
+
+        if (intent.kind == SINGLE) {
+            const uint64_t press = find_press(outputs, &pos, own, intent.begin, intent.end);
+            singles++;
+            if (press == 0) {
+                lost++;
+            } else {
+                const uint64_t delay = press - intent.begin;
+                const uint64_t step = delay > 0 ? (delay - 1) / (10 * MS) : 0;
+                delays[step < 5 ? step : 5]++;
+            }
+        } else {
+            intended++;
+            if (chord != 0) hits++;
+            if (intent.kind == CHORD && find_press(outputs, &pos, own, intent.begin, intent.end) != 0) leaked++;
+        }
+    }
+
+    const uint64_t missed = intended - hits;
+    const uint64_t false_triggers = chord_presses - hits;
+    const WP::Histogram &delay = chords.get_delay();
+
+    printf("\nreplay: %llu chords, %llu missed, %llu false triggers, %llu chord buttons leaked into a chord\n",
+           (unsigned long long) intended, (unsigned long long) missed, (unsigned long long) false_triggers,
+           (unsigned long long) leaked);
+    printf("replay: %llu single presses of chord buttons, %llu lost, delay:\n", (unsigned long long) singles,
+           (unsigned long long) lost);
+    for (int i = 0; i < 5; ++i) {
+        printf("  <= %d ms %6llu\n", (i + 1) * 10, (unsigned long long) delays[i]);
+    }
+    printf("  >  50 ms %6llu\n", (unsigned long long) delays[5]);
+    printf("replay: chord engine delay p50 %.1f ms p99 %.1f ms max %.1f ms\n", delay.get_percentile(0.5) / 1000000.0,
+           delay.get_percentile(0.99) / 1000000.0, delay.get_max() / 1000000.0);
+
+    // presses alone wait at most the 50 ms window
+    if (missed > 0 || false_triggers > 0 || leaked > 0 || lost > 0 || delays[5] > 0) {
+        printf("replay  <- FAILED\n");
+        g_wp_failed++;
+    }
+
+}
+
+
+
+// A+B is a chord on Z, A and B alone press X and Y
+int
+main(int argc, char **argv)
+{
+
+    if (argc < 2) {
+        printf("usage: %s chords.json\n", argv[0]);
+        return 1;
+    }
+
+    WP::Map map;
+    WP::Config config;
+    if (!config.load(argv[1], &map)) return 1;
+
+    WP::DeviceConfig &out = config.output;
+    WP::DeviceConfig *in = config.inputs[0];
+    WP::TargetDevice target(out.name, out.vendor, out.product, out.version, out.axes, out.buttons);
+    map.compile(&target);
+    WP::SourceDevice src(in->name, in->vendor, in->product, in->version, in->axes, in->buttons);
+    src.load_ranges();
+    src.set_listener(&target);
+    target.init(&map);
+
+    Replay replay(&src, &target);
+    if (!replay.open()) return 1;
+    uint64_t t = 1000 * MS;
+
+    // a held chord button with key repeat must not fall back to its own mapping
+    replay.button("A", 1, t);
+    replay.button("B", 1, t + 10 * MS);
+    expect(replay, "A+B pressed", 0, 0, 1);
+    replay.button("A", 2, t + 300 * MS);
+    replay.button("A", 2, t + 330 * MS);
+    replay.advance(t + 500 * MS);
+    expect(replay, "A repeats while the chord is down", 0, 0, 1);
+    replay.button("A", 0, t + 600 * MS);
+    expect(replay, "A released", 0, 0, 0);
+    replay.button("B", 0, t + 620 * MS);
+    expect(replay, "B released", 0, 0, 0);
+
+    // a press that timed out and was passed on stays a single press
+    t += 2000 * MS;
+    replay.button("A", 1, t);
+    replay.advance(t + 60 * MS);
+    expect(replay, "A held past the window", 1, 0, 0);
+    replay.button("A", 2, t + 300 * MS);
+    replay.advance(t + 400 * MS);
+    expect(replay, "A repeats", 1, 0, 0);
+    replay.button("A", 0, t + 500 * MS);
+    expect(replay, "A released", 0, 0, 0);
+
+    // a repeat inside the window does not restart it
+    t += 2000 * MS;
+    replay.button("A", 1, t);
+    replay.button("A", 2, t + 40 * MS);
+    replay.advance(t + 60 * MS);
+    expect(replay, "A repeats inside the window", 1, 0, 0);
+    replay.button("A", 0, t + 100 * MS);
+    expect(replay, "A released", 0, 0, 0);
+
+    // a button held past the window still completes the chord, its own mapping stays down
+    t += 2000 * MS;
+    replay.button("A", 1, t);
+    replay.advance(t + 300 * MS);
+    expect(replay, "A held past the window", 1, 0, 0);
+    replay.button("B", 1, t + 400 * MS);
+    expect(replay, "B pressed while A is held", 1, 0, 1);
+    replay.button("B", 0, t + 500 * MS);
+    expect(replay, "B released", 1, 0, 0);
+    replay.button("B", 1, t + 600 * MS);
+    expect(replay, "B pressed again", 1, 0, 1);
+    replay.button("A", 0, t + 700 * MS);
+    expect(replay, "A released", 0, 0, 0);
+    replay.button("B", 0, t + 800 * MS);
+    expect(replay, "B released", 0, 0, 0);
+
+    replay_trace(&replay, target.get_chords(), t + 2000 * MS);
+
+    return g_wp_failed == 0 ? 0 : 1;
+
+}
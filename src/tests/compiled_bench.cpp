@@ -0,0 +1,225 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../axis.h"
+#include "../button.h"
+#include "../compiledmap.h"
+#include "../config.h"
+#include "../map.h"
+#include "../sourcedevice.h"
+#include "../targetdevice.h"
+
+
+#define MS 1000000ULL
+
+#define WP_BENCH_FRAMES 60000 // a minute at 1 kHz
+#define WP_BENCH_ROUNDS 20
+
+
+
+static uint32_t g_wp_seed = 7;
+
+
+static uint32_t
+next_random()
+{
+
+    g_wp_seed ^= g_wp_seed << 13;
+    g_wp_seed ^= g_wp_seed >> 17;
+    g_wp_seed ^= g_wp_seed << 5;
+    return g_wp_seed;
+
+}
+
+
+static double
+elapsed_ns(const struct timespec &start, const struct timespec &end)
+{
+
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+}
+
+
+static void
+add_event(std::vector<struct input_event> *trace, uint64_t time, uint16_t type, uint16_t code, int32_t value)
+{
+
+    struct input_event event;
+    memset(&event, 0, sizeof(event));
+    event.time.tv_sec = time / 1000000000;
+    event.time.tv_usec = (time % 1000000000) / 1000;
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    trace->push_back(event);
+
+}
+
+
+// a lap on a pad: steering in every frame, a pedal in most, a button now and then; with
+// random set, every frame moves a random axis or button to a random value
+static void
+build_trace(const WP::DeviceConfig *in, bool random, std::vector<struct input_event> *trace)
+{
+
+    const WP::Axis *steering = in->axes[0];
+    const WP::Axis *throttle = in->axes[1];
+    const WP::Axis *brake = in->axes[2];
+    int32_t pressed = -1;
+
+    for (int f = 0; f < WP_BENCH_FRAMES; ++f) {
+        const uint64_t time = 1000 * MS + f * MS;
+
+        if (random) {
+            const size_t i = next_random() % (in->axes.size() + in->buttons.size());
+            if (i < in->axes.size()) {
+                const WP::Axis *axis = in->axes[i];
+                const int32_t value = axis->get_min() + next_random() % ((int64_t) axis->get_max() - axis->get_min() + 1);
+                add_event(trace, time, EV_ABS, axis->get_code(), value);
+            } else {
+                add_event(trace, time, EV_KEY, in->buttons[i - in->axes.size()]->get_code(), next_random() & 1);
+            }
+            add_event(trace, time, EV_SYN, SYN_REPORT, 0);
+            continue;
+        }
+
+        const double phase = f / 4000.0 * 2 * M_PI; // a corner every 4 s
+        add_event(trace, time, EV_ABS, steering->get_code(), (int32_t) (sin(phase) * 20000) + (int32_t) (next_random() % 64));
+
+        const int32_t pedal = (int32_t) (fabs(cos(phase)) * 255);
+        if (f % 4 != 0) add_event(trace, time, EV_ABS, cos(phase) > 0 ? throttle->get_code() : brake->get_code(), pedal);
+
+        if (f % 500 == 0) {
+            if (pressed >= 0) add_event(trace, time, EV_KEY, in->buttons[pressed]->get_code(), 0);
+            pressed = pressed >= 0 ? -1 : next_random() % in->buttons.size();
+            if (pressed >= 0) add_event(trace, time, EV_KEY, in->buttons[pressed]->get_code(), 1);
+        }
+
+        add_event(trace, time, EV_SYN, SYN_REPORT, 0);
+    }
+
+}
+
+
+// ns per input event through SourceDevice::read_events() into the target device, the fastest
+// round; state gets the output axes and buttons after the trace
+static double
+run(const char *file, bool compiled, const std::vector<struct input_event> &trace, std::vector<int32_t> *state)
+{
+
+    WP::Map map;
+    WP::Config config;
+    if (!config.load(file, &map)) return 0;
+
+    WP::DeviceConfig &out = config.output;
+    WP::DeviceConfig *in = config.inputs[0];
+    WP::TargetDevice target(out.name, out.vendor, out.product, out.version, out.axes, out.buttons);
+    map.compile(&target);
+    if (compiled) {
+        if (g_wp_compiled_map.fingerprint != map.get_fingerprint()) {
+            printf("\"%s\" is not the config compiled from \"%s\"\n", file, g_wp_compiled_map.config);
+            return 0;
+        }
+        target.set_compiled_map(&g_wp_compiled_map);
+    }
+
+    WP::SourceDevice src(in->name, in->vendor, in->product, in->version, in->axes, in->buttons);
+    src.load_ranges();
+    src.set_listener(&target);
+    target.init(&map);
+
+    // the target has no node, frames are built and dropped where they would be written
+    FILE *f = tmpfile();
+    if (f == nullptr || fwrite(trace.data(), sizeof(struct input_event), trace.size(), f) != trace.size() ||
+            fflush(f) != 0) {
+        perror("tmpfile");
+        return 0;
+    }
+    const int fd = dup(fileno(f));
+    fclose(f);
+    src.open_replay(fd);
+
+    double best = 0;
+    for (int r = 0; r < WP_BENCH_ROUNDS; ++r) {
+        const uint64_t begin = src.get_stats().events;
+        struct timespec start, end;
+
+        lseek(fd, 0, SEEK_SET);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (src.get_stats().events - begin < trace.size() && src.read_events()) { }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        const double ns = elapsed_ns(start, end) / trace.size();
+        if (best == 0 || ns < best) best = ns;
+    }
+
+    for (size_t i = 0, c = target.get_axis_count(); i < c; ++i) state->push_back(target.get_axis_value(i));
+    for (size_t i = 0, c = target.get_button_count(); i < c; ++i) state->push_back(target.get_button_down(i));
+    return best;
+
+}
+
+
+
+// the config has to be the one wp-compile was run on at build time
+int
+main(int argc, char **argv)
+{
+
+    if (argc < 2) {
+        printf("usage: %s config.json\n", argv[0]);
+        return 1;
+    }
+
+    WP::Map map;
+    WP::Config config;
+    if (!config.load(argv[1], &map)) return 1;
+
+    if (config.inputs[0]->axes.size() < 3 || config.inputs[0]->buttons.size() < 1) {
+        printf("the trace needs steering, throttle and brake as the first axes and a button\n");
+        return 1;
+    }
+
+    static const char *names[] = { "lap", "random" };
+    for (int i = 0; i < 2; ++i) {
+        std::vector<struct input_event> trace;
+        build_trace(config.inputs[0], i == 1, &trace);
+
+        std::vector<int32_t> interpreted_state;
+        std::vector<int32_t> compiled_state;
+        const double interpreted = run(argv[1], false, trace, &interpreted_state);
+        const double compiled = run(argv[1], true, trace, &compiled_state);
+        if (interpreted == 0 || compiled == 0) return 1;
+
+        printf("trace=\"%s\" events=\"%zu\" interpreted=\"%.2f ns\" compiled=\"%.2f ns\"%s\n",
+               names[i], trace.size(), interpreted, compiled,
+               interpreted_state != compiled_state ? " output differs" : "");
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,175 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+#include "../axis.h"
+#include "../curve.h"
+#include "../mapentry.h"
+
+
+#define WP_BENCH_ROUNDS 200
+#define WP_BENCH_VALUES 65536
+
+
+
+static double
+elapsed_ns(const struct timespec &start, const struct timespec &end)
+{
+
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+}
+
+
+// steering -32768..32767 to 0..65535 through the curve, in ns per value
+static double
+run(const WP::Curve *curve, const std::vector<int32_t> &values)
+{
+
+    WP::Axis src;
+    src.set_min(-32768);
+    src.set_max(32767);
+
+    WP::Axis target;
+    target.set_min(0);
+    target.set_max(65535);
+
+    WP::MapEntry entry(&src, &target);
+    if (curve != nullptr) entry.set_curve(curve);
+    std::vector<int32_t> knots;
+    entry.compile(&knots);
+    const WP::MapOp op = entry.get_op();
+
+    volatile int32_t sink;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < WP_BENCH_ROUNDS; ++r) {
+        for (int32_t v : values) {
+            asm volatile("" : "+r"(v));
+            if (op.code == WP::MapOp::AXIS_TO_AXIS_CURVE) {
+                sink = WP::curve_axis_value(op.operands.curve, knots.data(), v);
+            } else {
+                sink = WP::scale_axis_value(op.operands.scale, v);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    (void) sink;
+    return elapsed_ns(start, end) / ((double) WP_BENCH_ROUNDS * values.size());
+
+}
+
+
+// the same values through Curve::evaluate(), what the config loader pays per knot
+static double
+run_exact(const WP::Curve *curve, const std::vector<int32_t> &values)
+{
+
+    volatile double sink;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t v : values) {
+        asm volatile("" : "+r"(v));
+        sink = curve->evaluate((v + 32768) / 65535.0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    (void) sink;
+    return elapsed_ns(start, end) / values.size();
+
+}
+
+
+
+// per event cost of curves from none to a 64 point spline, it should not grow with the curve
+int
+main()
+{
+
+    // a random order, so neither the branches nor the knot loads follow a sweep
+    std::vector<int32_t> values(WP_BENCH_VALUES);
+    uint32_t seed = 7;
+    for (size_t i = 0; i < values.size(); ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        values[i] = (int32_t) (seed & 0xffff) - 32768;
+    }
+
+    WP::Curve linear;
+
+    WP::Curve gamma;
+    gamma.set_gamma(2.2);
+
+    WP::Curve shaped;
+    shaped.set_deadzone(0.05);
+    shaped.set_saturation(0.95);
+    shaped.set_gamma(1.7);
+    shaped.set_center(true);
+
+    WP::Curve points;
+    points.set_points({ { 0, 0 }, { 0.5, 0.3 }, { 1, 1 } }, false);
+
+    std::vector<WP::Curve::Point> knots16;
+    std::vector<WP::Curve::Point> knots64;
+    for (int i = 0; i <= 15; ++i) knots16.push_back(WP::Curve::Point(i / 15.0, (i / 15.0) * (i / 15.0)));
+    for (int i = 0; i <= 63; ++i) knots64.push_back(WP::Curve::Point(i / 63.0, (i / 63.0) * (i / 63.0) * (i / 63.0)));
+
+    WP::Curve spline16;
+    spline16.set_deadzone(0.02);
+    spline16.set_center(true);
+    spline16.set_points(knots16, true);
+
+    WP::Curve spline64;
+    spline64.set_deadzone(0.02);
+    spline64.set_gamma(1.3);
+    spline64.set_center(true);
+    spline64.set_points(knots64, true);
+
+    struct {
+        const char *name;
+        const WP::Curve *curve;
+    } cases[] = {
+        { "none", nullptr },
+        { "linear", &linear },
+        { "gamma", &gamma },
+        { "deadzone+saturation+gamma+center", &shaped },
+        { "3 points", &points },
+        { "16 point spline", &spline16 },
+        { "64 point spline+gamma", &spline64 },
+    };
+
+    for (const auto &c : cases) {
+        const double table = run(c.curve, values);
+        if (c.curve == nullptr) {
+            printf("curve=\"%s\" event=\"%.2f ns\"\n", c.name, table);
+        } else {
+            printf("curve=\"%s\" event=\"%.2f ns\" exact=\"%.2f ns\"\n", c.name, table, run_exact(c.curve, values));
+        }
+    }
+
+    return 0;
+
+}
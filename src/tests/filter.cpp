@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../filter.h"
+
+
+#define MS 1000000ULL
+
+
+
+static int g_wp_failed = 0;
+
+
+// a 0..255 pedal released in four reports 8 ms apart and then held at 0
+static void
+check_release(const char *name, const WP::Filter &filter)
+{
+
+    static const int32_t release[] = { 200, 120, 40, 0 };
+
+    WP::Filter::State state = { };
+    uint64_t time = 1000 * MS;
+    int32_t value = 0;
+
+    filter.reset(&state, 255, time);
+    for (int32_t raw : release) {
+        time += 8 * MS;
+        value = filter.apply(&state, raw, time);
+    }
+
+    // nothing else comes from the device, the event loop only has the timer
+    const uint64_t settle = filter.get_settle_time(&state);
+    const int32_t settled = settle != 0 ? filter.settle(&state) : value;
+    const bool ok = (settle == 0 || settle == time + WP_FILTER_SETTLE) && settled == 0 &&
+                    filter.get_settle_time(&state) == 0;
+    if (!ok) g_wp_failed++;
+
+    printf("%-20s after the last report=%3d settle in=%2llu ms settled=%3d%s\n", name, value,
+           (unsigned long long) (settle != 0 ? (settle - time) / MS : 0), settled, ok ? "" : "  <- FAILED");
+
+    // a value that repeats is passed through, with or without the timer
+    filter.apply(&state, 90, time + 30 * MS);
+    value = filter.apply(&state, 90, time + 31 * MS);
+    if (filter.get_settle_time(&state) != 0) value = filter.settle(&state);
+    if (value != 90) {
+        printf("%-20s repeated value=%d, expected 90  <- FAILED\n", name, value);
+        g_wp_failed++;
+    }
+
+}
+
+
+// steady input must not be moved by the timer
+static void
+check_steady(const char *name, const WP::Filter &filter)
+{
+
+    WP::Filter::State state = { };
+    uint64_t time = 1000 * MS;
+
+    filter.reset(&state, 64, time);
+    for (int i = 0; i < 100; ++i) {
+        time += MS;
+        filter.apply(&state, 64, time);
+    }
+
+    if (filter.get_settle_time(&state) != 0) {
+        printf("%-20s steady input wants to settle  <- FAILED\n", name);
+        g_wp_failed++;
+    }
+
+}
+
+
+
+int
+main()
+{
+
+    WP::Filter ema;
+    ema.add_ema(0.2);
+
+    WP::Filter median;
+    median.add_median3();
+
+    WP::Filter one_euro;
+    one_euro.add_one_euro(1.0, 5.0, 1.0, 255);
+
+    WP::Filter chain;
+    chain.add_median3();
+    chain.add_one_euro(1.0, 5.0, 1.0, 255);
+
+    check_release("ema 0.2", ema);
+    check_release("median3", median);
+    check_release("one_euro 1 Hz beta 5", one_euro);
+    check_release("median3 + one_euro", chain);
+
+    check_steady("ema 0.2", ema);
+    check_steady("median3", median);
+    check_steady("one_euro 1 Hz beta 5", one_euro);
+    check_steady("median3 + one_euro", chain);
+
+    return g_wp_failed == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,279 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../axis.h"
+#include "../config.h"
+#include "../map.h"
+#include "../sourcedevice.h"
+#include "../targetdevice.h"
+
+
+#define MS 1000000ULL
+
+// 8 s at 1 kHz: rest, a 1 s ramp, hold, a step down and hold again
+#define WP_REPLAY_LENGTH     8000
+#define WP_REPLAY_RAMP_BEGIN 2000
+#define WP_REPLAY_RAMP_END   3000
+#define WP_REPLAY_STEP       5000
+#define WP_REPLAY_REST       8000
+#define WP_REPLAY_HIGH       48000
+#define WP_REPLAY_LOW        16000
+#define WP_REPLAY_CASES      5
+
+
+
+struct Result {
+    uint64_t in;         // events the kernel would report, repeated values are dropped
+    uint64_t filtered;   // absorbed by the filter
+    uint64_t out;        // written by the target device
+    uint64_t suppressed; // unchanged output values that were not written
+    int hold_changes;    // output changes while the pedal is held
+    int hold_error;      // largest distance from the true output while held
+    int step_lag;        // ms until 90% of the step down
+    double ramp_lag;     // ms behind the true value on the ramp
+};
+
+
+
+static int g_wp_failed = 0;
+static uint32_t g_wp_seed = 7;
+
+
+static uint32_t
+next_random()
+{
+
+    // xorshift, the trace is the same everywhere
+    g_wp_seed ^= g_wp_seed << 13;
+    g_wp_seed ^= g_wp_seed >> 17;
+    g_wp_seed ^= g_wp_seed << 5;
+    return g_wp_seed;
+
+}
+
+
+static int32_t
+get_truth(int ms)
+{
+
+    if (ms < WP_REPLAY_RAMP_BEGIN) return WP_REPLAY_REST;
+    if (ms < WP_REPLAY_RAMP_END) {
+        return WP_REPLAY_REST + (WP_REPLAY_HIGH - WP_REPLAY_REST) * (ms - WP_REPLAY_RAMP_BEGIN) /
+                                (WP_REPLAY_RAMP_END - WP_REPLAY_RAMP_BEGIN);
+    }
+    if (ms < WP_REPLAY_STEP) return WP_REPLAY_HIGH;
+    return WP_REPLAY_LOW;
+
+}
+
+
+// 0..65535 pedal on a 0..4095 output axis
+static int32_t
+to_output(int32_t value)
+{
+
+    return (int32_t) ((int64_t) value * 4095 / 65535);
+
+}
+
+
+// a worn potentiometer: about +-40 of noise and a spike every half second
+static void
+build_trace(std::vector<int32_t> *trace)
+{
+
+    for (int ms = 0; ms < WP_REPLAY_LENGTH; ++ms) {
+        int32_t noise = 0;
+        for (int i = 0; i < 4; ++i) noise += (int32_t) (next_random() % 81) - 40;
+
+        int32_t value = get_truth(ms) + noise / 2;
+        if (next_random() % 500 == 0) value += (next_random() & 1) ? 8000 : -8000;
+
+        trace->push_back(value < 0 ? 0 : (value > 65535 ? 65535 : value));
+    }
+
+}
+
+
+static Result
+replay(WP::SourceDevice *src, WP::TargetDevice *target, uint16_t target_slot, const std::vector<int32_t> &trace)
+{
+
+    Result r = { };
+    const uint64_t events = target->get_stats().events;
+    const uint64_t suppressed = target->get_stats().suppressed;
+    const uint16_t code = src->get_axis_at(0)->get_code();
+
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK) != 0) {
+        perror("pipe2");
+        g_wp_failed++;
+        return r;
+    }
+    src->open_replay(fds[0]);
+
+
+    std::vector<int32_t> output(trace.size());
+    int32_t last = -1;
+    for (size_t ms = 0; ms < trace.size(); ++ms) {
+        if (trace[ms] != last) {
+            last = trace[ms];
+            r.in++;
+
+            struct input_event frame[2] = { };
+            const uint64_t time = 1000 * MS + ms * MS;
+            frame[0].time.tv_sec = time / 1000000000;
+            frame[0].time.tv_usec = (time % 1000000000) / 1000;
+            frame[0].type = EV_ABS;
+            frame[0].code = code;
+            frame[0].value = last;
+            frame[1].time = frame[0].time;
+            frame[1].type = EV_SYN;
+            frame[1].code = SYN_REPORT;
+
+            if (write(fds[1], frame, sizeof(frame)) != sizeof(frame) || !src->read_events()) {
+                perror("replay");
+                g_wp_failed++;
+                break;
+            }
+        }
+        output[ms] = target->get_axis_value(target_slot);
+    }
+
+    src->close();
+    ::close(fds[1]);
+
+
+    r.filtered = src->get_stats().filtered;
+    r.out = target->get_stats().events - events;
+    r.suppressed = target->get_stats().suppressed - suppressed;
+
+    for (int ms = WP_REPLAY_RAMP_END + 200; ms < WP_REPLAY_STEP; ++ms) {
+        const int error = output[ms] - to_output(WP_REPLAY_HIGH);
+        if (output[ms] != output[ms - 1]) r.hold_changes++;
+        if (error > r.hold_error) r.hold_error = error;
+        if (-error > r.hold_error) r.hold_error = -error;
+    }
+
+    const int32_t step_target = to_output(WP_REPLAY_HIGH - (WP_REPLAY_HIGH - WP_REPLAY_LOW) * 9 / 10);
+    r.step_lag = -1;
+    for (int ms = WP_REPLAY_STEP; ms < WP_REPLAY_LENGTH; ++ms) {
+        if (output[ms] <= step_target) {
+            r.step_lag = ms - WP_REPLAY_STEP;
+            break;
+        }
+    }
+
+    // mean distance behind the true value divided by the slope, without the start of the ramp
+    const double slope = (double) (to_output(WP_REPLAY_HIGH) - to_output(WP_REPLAY_REST)) /
+                         (WP_REPLAY_RAMP_END - WP_REPLAY_RAMP_BEGIN);
+    double behind = 0;
+    for (int ms = WP_REPLAY_RAMP_BEGIN + 300; ms < WP_REPLAY_RAMP_END - 100; ++ms) {
+        behind += to_output(get_truth(ms)) - output[ms];
+    }
+    r.ramp_lag = behind / (WP_REPLAY_RAMP_END - WP_REPLAY_RAMP_BEGIN - 400) / slope;
+
+    return r;
+
+}
+
+
+
+// every input device has the same pedal with another filter, each on its own output axis
+int
+main(int argc, char **argv)
+{
+
+    if (argc < 2) {
+        printf("usage: %s replay.json\n", argv[0]);
+        return 1;
+    }
+
+    WP::Map map;
+    WP::Config config;
+    if (!config.load(argv[1], &map)) return 1;
+
+    WP::DeviceConfig &out = config.output;
+    WP::TargetDevice target(out.name, out.vendor, out.product, out.version, out.axes, out.buttons);
+    map.compile(&target);
+
+    std::vector<WP::SourceDevice*> sources;
+    for (size_t i = 0, s = config.inputs.size(); i < s; ++i) {
+        WP::DeviceConfig *in = config.inputs[i];
+        WP::SourceDevice *src = new WP::SourceDevice(in->name, in->vendor, in->product, in->version, in->axes, in->buttons);
+        src->load_ranges();
+        src->set_listener(&target);
+        sources.push_back(src);
+    }
+
+    target.init(&map);
+    target.open_replay(open("/dev/null", O_WRONLY));
+
+    std::vector<int32_t> trace;
+    build_trace(&trace);
+
+
+    if (sources.size() != WP_REPLAY_CASES) {
+        printf("expected %d input devices\n", WP_REPLAY_CASES);
+        return 1;
+    }
+
+    printf("%-20s %5s %8s %5s %10s %13s %10s %8s %8s\n", "filter", "in", "filtered", "out", "suppressed",
+           "held changes", "held error", "step lag", "ramp lag");
+
+    // the output axes have the codes 0.. in the order of the input devices
+    Result results[WP_REPLAY_CASES];
+    for (size_t i = 0; i < WP_REPLAY_CASES; ++i) {
+        const Result &r = results[i] = replay(sources[i], &target, target.get_axis_index((uint16_t) i), trace);
+        printf("%-20s %5llu %8llu %5llu %10llu %13d %10d %5d ms %5.1f ms\n", sources[i]->get_name().c_str(),
+               (unsigned long long) r.in, (unsigned long long) r.filtered, (unsigned long long) r.out,
+               (unsigned long long) r.suppressed, r.hold_changes, r.hold_error, r.step_lag, r.ramp_lag);
+
+        // every input that was not absorbed by the filter is either written or suppressed
+        if (r.filtered + r.out + r.suppressed != r.in) {
+            printf("%-20s %llu events went missing  <- FAILED\n", sources[i]->get_name().c_str(),
+                   (unsigned long long) (r.in - r.filtered - r.out - r.suppressed));
+            g_wp_failed++;
+        }
+        if (r.step_lag < 0 || r.step_lag > 20) {
+            printf("%-20s step lag above 20 ms  <- FAILED\n", sources[i]->get_name().c_str());
+            g_wp_failed++;
+        }
+        if (i > 0 && (r.out >= results[0].out || r.hold_changes >= results[0].hold_changes)) {
+            printf("%-20s does not write less than the unfiltered axis  <- FAILED\n", sources[i]->get_name().c_str());
+            g_wp_failed++;
+        }
+    }
+
+    // median3 drops the spikes, 8000 on the input is 500 on the output
+    if (results[2].hold_error > 50 || results[4].hold_error > 50) {
+        printf("spikes got through median3  <- FAILED\n");
+        g_wp_failed++;
+    }
+
+    for (WP::SourceDevice *src : sources) delete src;
+
+    return g_wp_failed == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,119 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "../axis.h"
+#include "../mapentry.h"
+
+
+
+struct Range
+{
+
+    int32_t min;
+    int32_t max;
+
+};
+
+
+static WP::AxisScale
+make_scale(const Range &src, const Range &target, bool invert)
+{
+
+    WP::Axis a;
+    a.set_min(src.min);
+    a.set_max(src.max);
+
+    WP::Axis b;
+    b.set_min(target.min);
+    b.set_max(target.max);
+    b.set_invert(invert);
+
+    WP::MapEntry entry(&a, &b);
+    std::vector<int32_t> knots;
+    entry.compile(&knots);
+    return entry.get_op().operands.scale;
+
+}
+
+
+// target_min + round((clamp(value) - src_min) * target_range / src_range), halves round up
+static int64_t
+exact(const Range &src, const Range &target, bool invert, int64_t value)
+{
+
+    const int64_t src_range = (int64_t) src.max - src.min;
+    const int64_t target_range = (int64_t) target.max - target.min;
+    if (src_range <= 0 || target_range <= 0) return target.min;
+
+    int64_t x = value - src.min;
+    if (x < 0) x = 0;
+    else if (x > src_range) x = src_range;
+    if (invert) x = src_range - x;
+
+    const __int128 n = (__int128) 2 * x * target_range + src_range;
+    return target.min + (int64_t) (n / (2 * src_range));
+
+}
+
+
+
+// every 16-bit source value and a margin around it, against the exact rational result
+int
+main()
+{
+
+    const Range src[] = {
+        { 0, 65535 }, { -32768, 32767 }, { -32767, 32767 }, { 0, 1023 },
+        { 0, 255 }, { -1, 1 }, { 0, 1 }, { 100, 40000 }, { 7, 7 }
+    };
+    const Range target[] = {
+        { 0, 65535 }, { -32768, 32767 }, { 0, 1023 }, { 0, 255 }, { -1, 1 },
+        { 0, 16383 }, { 5, 7 }, { INT32_MIN, INT32_MAX }, { -2000000000, 2100000000 }
+    };
+
+    uint64_t checked = 0;
+    uint64_t failed = 0;
+
+    for (const Range &s : src) {
+        for (const Range &t : target) {
+            for (int invert = 0; invert < 2; ++invert) {
+                const WP::AxisScale scale = make_scale(s, t, invert);
+
+                for (int64_t v = -32768 - 16; v <= 65535 + 16; ++v) {
+                    const int64_t expected = exact(s, t, invert, v);
+                    const int32_t value = WP::scale_axis_value(scale, v);
+                    ++checked;
+                    if (value == expected) continue;
+
+                    if (failed++ < 10) {
+                        printf("%d..%d -> %d..%d invert=%d value=%lld: got %d, expected %lld\n",
+                               s.min, s.max, t.min, t.max, invert, (long long) v, value, (long long) expected);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("scale_axis_value: checked=\"%llu\" failed=\"%llu\"\n", (unsigned long long) checked, (unsigned long long) failed);
+    return failed == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,110 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "../axis.h"
+#include "../mapentry.h"
+
+
+#define WP_BENCH_ROUNDS 200
+
+
+
+// the float conversion axes used before WP::AxisScale, source -> percent -> target
+static int32_t
+scale_float(int32_t value, int32_t src_min, int32_t src_max, int32_t min, int32_t max, bool invert)
+{
+
+    const float src_distance = abs(src_max - src_min);
+    const float abs_value = src_min < 0 ? value + abs(src_min) : value;
+    float p = abs_value / src_distance;
+    if (invert) p = 1.0 - p;
+
+    const int64_t distance = abs(max - min);
+    return (distance * p) + (min > 0 ? min : (min < 0 ? min : 0 + max < 0 ? max : 0));
+
+}
+
+
+static double
+elapsed_ns(const struct timespec &start, const struct timespec &end)
+{
+
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+}
+
+
+
+// steering, -32768..32767 to 0..65535, every value WP_BENCH_ROUNDS times
+int
+main(int argc, char **)
+{
+
+    // not a constant the compiler could fold into the loops
+    const int32_t target_max = 65535 + argc - 1;
+
+    WP::Axis src;
+    src.set_min(-32768);
+    src.set_max(32767);
+
+    WP::Axis target;
+    target.set_min(0);
+    target.set_max(target_max);
+
+    WP::MapEntry entry(&src, &target);
+    std::vector<int32_t> knots;
+    entry.compile(&knots);
+    const WP::AxisScale scale = entry.get_op().operands.scale;
+
+    const double count = WP_BENCH_ROUNDS * 65536.0;
+    volatile int32_t sink;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < WP_BENCH_ROUNDS; ++r) {
+        for (int32_t v = -32768; v <= 32767; ++v) {
+            int32_t value = v;
+            asm volatile("" : "+r"(value));
+            sink = WP::scale_axis_value(scale, value);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double fixed = elapsed_ns(start, end) / count;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < WP_BENCH_ROUNDS; ++r) {
+        for (int32_t v = -32768; v <= 32767; ++v) {
+            int32_t value = v;
+            asm volatile("" : "+r"(value));
+            sink = scale_float(value, -32768, 32767, 0, target_max, false);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double fp = elapsed_ns(start, end) / count;
+
+    (void) sink;
+    printf("fixed-point=\"%.2f ns\" float=\"%.2f ns\"\n", fixed, fp);
+    return 0;
+
+}
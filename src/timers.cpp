@@ -0,0 +1,166 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "timers.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+
+
+namespace WP {
+
+
+
+Timers::Timers()
+{
+
+    m_fd = -1;
+    m_armed = 0;
+
+}
+
+
+Timers::~Timers()
+{
+
+    close();
+
+}
+
+
+bool
+Timers::open()
+{
+
+    // same clock as the input timestamps and Utils::get_time()
+    m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+
+    m_armed = 0;
+    arm();
+    return true;
+
+}
+
+
+void
+Timers::close()
+{
+
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+}
+
+
+int
+Timers::get_fd() const
+{
+
+    return m_fd;
+
+}
+
+
+void
+Timers::set_timer(WP::Timers::Listener *listener, uint64_t time)
+{
+
+    size_t i = 0;
+    const size_t s = m_timers.size();
+    while (i < s && m_timers[i].listener != listener) ++i;
+
+    if (i == s) {
+        WP::Timers::Timer timer = { listener, 0 };
+        m_timers.push_back(timer);
+    }
+
+    if (m_timers[i].time == time) return;
+    m_timers[i].time = time;
+    arm();
+
+}
+
+
+void
+Timers::read_events()
+{
+
+    uint64_t expirations;
+    if (read(m_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN && errno != EINTR) {
+        perror("read timerfd");
+    }
+
+    // the fd only fires for the earliest time, every listener that is due runs now;
+    // listeners may set their next time from onTimer()
+    const uint64_t now = WP::Utils::get_time();
+    m_armed = 0;
+
+    for (size_t i = 0; i < m_timers.size(); ++i) {
+        if (m_timers[i].time == 0 || m_timers[i].time > now) continue;
+
+        m_timers[i].time = 0;
+        m_timers[i].listener->onTimer(now);
+    }
+
+    arm();
+
+}
+
+
+void
+Timers::arm()
+{
+
+    if (m_fd < 0) return;
+
+    uint64_t next = 0;
+    for (size_t i = 0, s = m_timers.size(); i < s; ++i) {
+        const uint64_t time = m_timers[i].time;
+        if (time != 0 && (next == 0 || time < next)) next = time;
+    }
+
+    if (next == m_armed) return; // 0 disarms
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = next / 1000000000ULL;
+    spec.it_value.tv_nsec = next % 1000000000ULL;
+
+    if (timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        perror("timerfd_settime");
+        return;
+    }
+
+    m_armed = next;
+
+}
+
+
+
+} // namespace WP
@@ -0,0 +1,80 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+
+namespace WP {
+
+
+
+// one timerfd for everything that needs to wake up the event loop at a given time
+class Timers
+{
+
+
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() { }
+        virtual void onTimer(uint64_t now) = 0;
+    };
+
+
+    Timers();
+    ~Timers();
+
+    bool open();
+    void close();
+
+    int get_fd() const;
+
+    // one pending time per listener in Utils::get_time() nanoseconds, 0 cancels it
+    void set_timer(WP::Timers::Listener *listener, uint64_t time);
+    void read_events();
+
+
+private:
+    struct Timer {
+        WP::Timers::Listener *listener;
+        uint64_t time;
+    };
+
+    int m_fd;
+    std::vector<WP::Timers::Timer> m_timers;
+    uint64_t m_armed;
+
+    void arm();
+
+
+};
+
+
+
+} // namespace WP
+
+
+
+#endif // TIMERS_H
@@ -0,0 +1,321 @@
+/*
+   Copyright (C) 2017 Kai Dombrowe <just89@gmx.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "../../config.h"
+#include "../../device.h"
+#include "../../axis.h"
+#include "../../button.h"
+#include "../../map.h"
+#include "../../mapentry.h"
+#include "../../targetdevice.h"
+
+
+
+// the output device layout, only used to resolve the target slots
+class Layout : public WP::Device
+{
+
+public:
+    Layout(WP::DeviceConfig *out)
+        : WP::Device(out->name, out->vendor, out->product, out->version, out->axes, out->buttons) { }
+
+    bool open() { return true; }
+    void close() { }
+
+};
+
+
+
+static std::string
+format(const char *fmt, ...)
+{
+
+    char buffer[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    return buffer;
+
+}
+
+
+static std::string
+escape(const std::string &str)
+{
+
+    std::string ret;
+    for (size_t i = 0, s = str.size(); i < s; ++i) {
+        if (str[i] == '"' || str[i] == '\\') ret += '\\';
+        if (str[i] == '\n') {
+            ret += ' ';
+            continue;
+        }
+        ret += str[i];
+    }
+    return ret;
+
+}
+
+
+static void
+write_table(size_t id, uint32_t size, const int32_t *values, std::string *decls)
+{
+
+    *decls += format("static const int32_t k_table_%zu[%" PRIu32 "] = {", id, size);
+    for (uint32_t x = 0; x < size; ++x) {
+        *decls += format("%s%" PRId32 ",", x % 8 == 0 ? "\n    " : " ", values[x]);
+    }
+    *decls += "\n};\n\n";
+
+}
+
+
+static void
+write_op(uint32_t index, const WP::MapOp &op, const int32_t *curves, uint32_t table_size, size_t *constants, std::string *decls, std::string *cases)
+{
+
+    switch (op.code) {
+    case WP::MapOp::AXIS_TO_AXIS: {
+        const WP::AxisScale &scale = op.operands.scale;
+        const size_t id = (*constants)++;
+
+        if (scale.src_range > 0 && (uint64_t) scale.src_range + 1 <= table_size) {
+            const uint32_t size = scale.src_range + 1;
+            std::vector<int32_t> values(size);
+            for (uint32_t x = 0; x < size; ++x) {
+                values[x] = WP::scale_axis_value(scale, scale.src_min + (int64_t) x);
+            }
+            write_table(id, size, values.data(), decls);
+
+            *cases += format("        target->emit_axis(%u, k_table_%zu[table_index(value, %" PRId32 ", %" PRIu32 ")], %u);\n",
+                             op.slot, id, scale.src_min, size, op.flags);
+        } else {
+            *decls += format("static const WP::AxisScale k_scale_%zu = { %" PRId32 ", %" PRIu32 "u, %" PRId32 ", %u, %s, { %" PRIu64 "ull, %" PRIu64 "ull } };\n\n",
+                             id, scale.src_min, scale.src_range, scale.target_min, scale.shift,
+                             scale.invert ? "true" : "false", scale.mul[0], scale.mul[1]);
+
+            *cases += format("        target->emit_axis(%u, WP::scale_axis_value(k_scale_%zu, value), %u);\n",
+                             op.slot, id, op.flags);
+        }
+        break;
+    }
+    case WP::MapOp::AXIS_TO_AXIS_CURVE: {
+        const WP::AxisCurve &curve = op.operands.curve;
+        const size_t id = (*constants)++;
+
+        if (curve.src_range > 0 && (uint64_t) curve.src_range + 1 <= table_size) {
+            const uint32_t size = curve.src_range + 1;
+            std::vector<int32_t> values(size);
+            for (uint32_t x = 0; x < size; ++x) {
+                values[x] = WP::curve_axis_value(curve, curves, curve.src_min + (int64_t) x);
+            }
+            write_table(id, size, values.data(), decls);
+
+            *cases += format("        target->emit_axis(%u, k_table_%zu[table_index(value, %" PRId32 ", %" PRIu32 ")], %u);\n",
+                             op.slot, id, curve.src_min, size, op.flags);
+        } else {
+            write_table(id, WP_CURVE_SEGMENTS + 1, curves + curve.offset, decls);
+            *decls += format("static const WP::AxisCurve k_curve_%zu = { %" PRId32 ", %" PRIu32 "u, 0, %" PRIu64 "ull };\n\n",
+                             id, curve.src_min, curve.src_range, curve.step);
+
+            *cases += format("        target->emit_axis(%u, WP::curve_axis_value(k_curve_%zu, k_table_%zu, value), %u);\n",
+                             op.slot, id, id, op.flags);
+        }
+        break;
+    }
+    case WP::MapOp::AXIS_TO_COMBINE: {
+        // the target device evaluates the combine at the end of the frame
+        const WP::AxisScale &scale = op.operands.scale;
+        const size_t id = (*constants)++;
+
+        *decls += format("static const WP::AxisScale k_scale_%zu = { %" PRId32 ", %" PRIu32 "u, %" PRId32 ", %u, %s, { %" PRIu64 "ull, %" PRIu64 "ull } };\n\n",
+                         id, scale.src_min, scale.src_range, scale.target_min, scale.shift,
+                         scale.invert ? "true" : "false", scale.mul[0], scale.mul[1]);
+
+        *cases += format("        target->set_combine_input(%" PRIu32 ", %u, WP::scale_axis_value(k_scale_%zu, value));\n",
+                         index, op.slot, id);
+        break;
+    }
+    case WP::MapOp::AXIS_TO_BUTTON:
+        *cases += format("        target->emit_button(%u, value >= %" PRId32 " && value <= %" PRId32 ", %u);\n",
+                         op.slot, op.operands.range[0], op.operands.range[1], op.flags);
+        break;
+    case WP::MapOp::BUTTON_TO_BUTTON:
+        *cases += format("        target->emit_button(%u, value != 0, %u);\n", op.slot, op.flags);
+        break;
+    case WP::MapOp::BUTTON_TO_AXIS:
+        *cases += format("        target->emit_axis(%u, value != 0 ? %" PRId32 " : %" PRId32 ", %u);\n",
+                         op.slot, op.operands.values[1], op.operands.values[0], op.flags);
+        break;
+    case WP::MapOp::BUTTON_TO_MACRO:
+        *cases += format("        if (value != 0) target->start_macro(%u);\n", op.slot);
+        break;
+    case WP::MapOp::BUTTON_TO_CHORD:
+        // matched by the target device before the dispatch, which only runs the button's own ops
+        break;
+    default: break;
+    }
+
+}
+
+
+static void
+write_source(const WP::Map *map, const WP::DeviceConfig *in, const WP::EventSource *src, uint32_t table_size,
+             size_t *constants, std::string *decls, std::string *cases)
+{
+
+    size_t count;
+    const WP::MapEntry *entries = map->get_entries(src, &count);
+    if (count < 1) return;
+
+    *cases += format("    case %" PRIu32 ": // \"%s\" %s \"%s\"\n", src->get_map_begin(), escape(in->name).c_str(),
+                     src->get_type() == WP::EventSource::TYPE_AXIS ? "axis" : "button", escape(src->get_name()).c_str());
+    for (size_t i = 0; i < count; ++i) {
+        write_op(src->get_map_begin() + i, entries[i].get_op(), map->get_curves(), table_size, constants, decls, cases);
+    }
+    *cases += "        break;\n";
+
+}
+
+
+static bool
+write_map(const char *config_file, const char *output_file, uint32_t table_size)
+{
+
+    WP::Map map;
+    WP::Config config;
+    if (!config.load(config_file, &map)) {
+        return false;
+    }
+
+    Layout layout(&config.output);
+    map.compile(&layout);
+
+
+    size_t constants = 0;
+    std::string decls;
+    std::string cases;
+
+    for (size_t d = 0, dS = config.inputs.size(); d < dS; ++d) {
+        const WP::DeviceConfig *in = config.inputs[d];
+
+        for (size_t i = 0, s = in->axes.size(); i < s; ++i) {
+            write_source(&map, in, in->axes[i], table_size, &constants, &decls, &cases);
+        }
+        for (size_t i = 0, s = in->buttons.size(); i < s; ++i) {
+            write_source(&map, in, in->buttons[i], table_size, &constants, &decls, &cases);
+        }
+    }
+
+
+    FILE *f = fopen(output_file, "w");
+    if (f == nullptr) {
+        perror(output_file);
+        return false;
+    }
+
+    fprintf(f, "// generated by wp-compile from \"%s\", do not edit\n\n", escape(config_file).c_str());
+    fprintf(f, "#include \"compiledmap.h\"\n#include \"mapentry.h\"\n#include \"targetdevice.h\"\n\n\n\n");
+    fprintf(f,
+            "static inline uint32_t\n"
+            "table_index(int32_t value, int32_t min, uint32_t size)\n"
+            "{\n\n"
+            "    const int64_t x = (int64_t) value - min;\n"
+            "    return x < 0 ? 0 : (x >= size ? size - 1 : x);\n\n"
+            "}\n\n\n");
+    fprintf(f, "%s\n", decls.c_str());
+    fprintf(f,
+            "static void\n"
+            "dispatch(WP::TargetDevice *target, uint32_t begin, int32_t value)\n"
+            "{\n\n"
+            "    switch (begin) {\n"
+            "%s"
+            "    default: break;\n"
+            "    }\n\n"
+            "}\n\n\n", cases.c_str());
+    fprintf(f, "const WP::CompiledMap g_wp_compiled_map = { %" PRIu64 "ull, \"%s\", dispatch };\n",
+            map.get_fingerprint(), escape(config_file).c_str());
+
+    if (fclose(f) != 0) {
+        perror(output_file);
+        return false;
+    }
+
+    return true;
+
+}
+
+
+static void
+print_usage(const char *cmd)
+{
+
+    printf("usage: %s [--table-size N] --config FILE --output FILE.cpp\n", cmd);
+
+}
+
+
+
+int main(int argc, char **argv)
+{
+
+    const char *config_file = nullptr;
+    const char *output_file = nullptr;
+    long table_size = WP_TABLE_MAX_SIZE;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
+            config_file = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
+            output_file = argv[++i];
+        } else if (strcmp(argv[i], "--table-size") == 0) {
+            char *end = nullptr;
+            table_size = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || table_size < 0 || table_size > UINT32_MAX) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (config_file == nullptr || output_file == nullptr) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    return write_map(config_file, output_file, table_size) ? 0 : 1;
+
+}
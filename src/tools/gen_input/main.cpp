@@ -28,6 +28,7 @@
 #include <stdint.h>
 
 #include "../../3rdparty/json/json.hpp"
+#include "../../discovery.h"
 
 
 
@@ -67,6 +68,39 @@ add_info(int fd, nlohmann::json &json)
 }
 
 
+static void
+add_location(const char *path, nlohmann::json &json)
+{
+    const char *handler = strrchr(path, '/');
+    handler = handler != nullptr ? handler + 1 : path;
+
+    WP::Discovery::DeviceInfo info;
+    if (!WP::Discovery::find_handler(handler, &info)) {
+        return;
+    }
+
+    if (info.phys.size() > 0) json["phys"] = info.phys;
+    if (info.uniq.size() > 0) json["uniq"] = info.uniq;
+}
+
+
+static void
+list_devices()
+{
+    std::vector<WP::Discovery::DeviceInfo> devices;
+    if (!WP::Discovery::scan(&devices)) {
+        return;
+    }
+
+    for (size_t i = 0, s = devices.size(); i < s; ++i) {
+        const WP::Discovery::DeviceInfo &info = devices[i];
+        printf("/dev/input/%s: name=\"%s\" vendor=\"%d\" product=\"%d\" version=\"%d\" phys=\"%s\" uniq=\"%s\"\n",
+               info.handler.c_str(), info.name.c_str(), info.vendor, info.product, info.version,
+               info.phys.c_str(), info.uniq.c_str());
+    }
+}
+
+
 static void
 add_buttons(int fd, nlohmann::json &json)
 {
@@ -118,9 +152,15 @@ int main(int argc, char **argv)
 
     if (argc < 2) {
         printf("usage: %s /dev/input/eventXX\n", argv[0]);
+        printf("       %s --list\n", argv[0]);
         return 1;
     }
 
+    if (strcmp(argv[1], "-l") == 0 || strcmp(argv[1], "--list") == 0) {
+        list_devices();
+        return 0;
+    }
+
     const int fd = open(argv[1], O_RDONLY);
     if (fd < 1) {
         perror("open");
@@ -130,6 +170,7 @@ int main(int argc, char **argv)
     nlohmann::json json;
     add_name(fd, json["input"]);
     add_info(fd, json["input"]);
+    add_location(argv[1], json["input"]);
     add_buttons(fd, json["input"]["buttons"]);
     add_axes(fd, json["input"]["axes"]);
     printf("%s\n", json.dump(4).c_str());
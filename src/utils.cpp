@@ -19,12 +19,34 @@
 
 #include "utils.h"
 
+#include <time.h>
+
 
 
 namespace WP {
 
 
 
+uint64_t
+Utils::get_time()
+{
+
+    // monotonic time in nanoseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+}
+
+
+uint64_t
+Utils::get_time(const struct timeval &tv)
+{
+
+    return (uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_usec * 1000ULL;
+
+}
+
 
 
 } // namespace WP
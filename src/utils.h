@@ -22,7 +22,9 @@
 
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <iostream>
+#include <sys/time.h>
 
 namespace WP {
 
@@ -39,6 +41,9 @@ public:
         cont.clear();
     }
 
+    static uint64_t get_time();
+    static uint64_t get_time(const struct timeval &tv);
+
 
 };
 